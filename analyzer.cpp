@@ -15,24 +15,19 @@ namespace ptb {
 
 analyzer::analyzer()
 {
-    m_scope_counter = 0;
 }
 
 void analyzer::run(const ast::node_ptr &node)
 {
-    m_scope_counter = 0;
     m_symtable = std::make_shared<symbol_table>();
 
     if (node->type != ast::program_node) {
         throw semantic_error("AST nao e um programa valido!");
     }
 
-    int global_sid = get_next_scope();
-
     // cria o escopo global
-    m_global = std::make_shared<scope>(nullptr, global_sid);
-    m_stack.push(m_global);
-    m_symtable->put_scope(global_sid, m_global);
+    int global_sid = m_symtable->new_scope(-1);
+    m_symtable->enter(global_sid);
 
     auto program = ast::to_program(node);
     if (program->declarations.empty()) {
@@ -41,6 +36,7 @@ void analyzer::run(const ast::node_ptr &node)
     for (size_t i = 0; i < program->declarations.size(); i++) {
         analyze_node(program->declarations[i]);
     }
+    m_symtable->leave();
 }
 
 symbol_table_ptr analyzer::get_symtable()
@@ -75,6 +71,15 @@ void analyzer::analyze_node(const ast::node_ptr &node)
     case ast::assign_stmt_node:
         analyze_assign_stmt(node);
         break;
+    case ast::call_node:
+        analyze_call(node);
+        break;
+    case ast::integer_node:
+        analyze_integer(node);
+        break;
+    case ast::string_node:
+        analyze_lstring(node);
+        break;
     case ast::argument_node:
         analyze_argument(node);
         break;
@@ -97,36 +102,42 @@ void analyzer::analyze_function_decl(const ast::node_ptr &node)
 {
     auto func = ast::to_function_decl(node);
 
-    auto curr_scope = m_stack.top();
+    auto curr_scope = m_symtable->current();
 
     // Verifica se o simbolo já existe na tabela de símbolos
-    auto sym = curr_scope->get(func->name);
+    auto sym = m_symtable->lookup(func->name);
     if (!sym.is_valid()) {
 
-        int sid = get_next_scope();
+        // cria o novo escopo
+        int sid = m_symtable->new_scope(curr_scope);
 
         // insere o simbolo no escopo atual
-        curr_scope->insert(func->name,
-                           symbol(func->name,
-                                 compute_type(func->return_type) | types::function, sid));
+        func->sym = &m_symtable->insert(symbol(func->name,
+                                               compute_type(func->return_type) | types::function, sid));
 
-        // cria o novo escopo
-        auto fscope = std::make_shared<scope>(curr_scope, sid);
-        m_symtable->put_scope(sid, fscope);
         // empilha o escopo e insere os argumentos nele
-        m_stack.push(fscope);
+        m_symtable->enter(sid);
         for (size_t i = 0; i < func->arguments.size(); i++) {
             analyze_node(func->arguments[i]);
         }
-        m_stack.pop();
-        sym = curr_scope->get(func->name);
+        m_symtable->leave();
+        sym = m_symtable->lookup(func->name);
+    } else {
+        func->sym = m_symtable->find(func->name);
     }
     // empilha o escopo da função e analisa os statements
-    m_stack.push(m_symtable->get_scope(sym.scope_id));
+    m_symtable->enter(sym.scope_id);
+    // a definição de uma função já prototipada usa os argumentos do protótipo
+    for (size_t i = 0; i < func->arguments.size(); i++) {
+        auto arg = ast::to_argument(func->arguments[i]);
+        if (arg->sym == nullptr) {
+            arg->sym = m_symtable->find(arg->name);
+        }
+    }
     for (size_t i = 0; i < func->statements.size(); i++) {
         analyze_node(func->statements[i]);
     }
-    m_stack.pop();
+    m_symtable->leave();
 }
 
 // Analisa a declaração de variáveis
@@ -140,50 +151,52 @@ void analyzer::analyze_variable_decl(const ast::node_ptr &node)
             throw semantic_error("Atribuicao invalida encontrada, tipos incompativeis!");
         }
     }
-    auto curr_scope = m_stack.top();
-    auto sym = curr_scope->get(var->name);
-    if (!sym.is_valid()) {
-        curr_scope->insert(var->name, symbol(var->name, type));
+    var->sym = m_symtable->find(var->name);
+    if (var->sym == nullptr) {
+        var->sym = &m_symtable->insert(symbol(var->name, type));
     }
     analyze_node(var->value);
 }
 
-void analyzer::analyze_integer(const ast::node_ptr &node) {}
-void analyzer::analyze_lstring(const ast::node_ptr &node) {}
+void analyzer::analyze_integer(const ast::node_ptr &node)
+{
+    compute_type(node);
+}
+
+void analyzer::analyze_lstring(const ast::node_ptr &node)
+{
+    compute_type(node);
+}
 
 void analyzer::analyze_if_stmt(const ast::node_ptr &node)
 {
     auto ifstmt = ast::to_if_stmt(node);
 
-    auto curr_scope = m_stack.top();
+    auto curr_scope = m_symtable->current();
 
     analyze_node(ifstmt->eval_expr);
 
 
     if (!ifstmt->true_statements.empty()) {
-        int sid = get_next_scope();
         // cria o novo escopo para o escopo verdadeiro
-        auto fscope = std::make_shared<scope>(curr_scope, sid);
-        m_symtable->put_scope(sid, fscope);
+        int sid = m_symtable->new_scope(curr_scope);
         // empilha o escopo e analisa os statements nele
-        m_stack.push(fscope);
+        m_symtable->enter(sid);
         for (size_t i = 0; i < ifstmt->true_statements.size(); i++) {
             analyze_node(ifstmt->true_statements[i]);
         }
-        m_stack.pop();
+        m_symtable->leave();
         ifstmt->true_scope_id = sid;
     }
     if (!ifstmt->false_statements.empty()) {
-        int sid = get_next_scope();
         // cria o novo escopo para o escopo verdadeiro
-        auto fscope = std::make_shared<scope>(curr_scope, sid);
-        m_symtable->put_scope(sid, fscope);
+        int sid = m_symtable->new_scope(curr_scope);
         // empilha o escopo e analisa os statements nele
-        m_stack.push(fscope);
+        m_symtable->enter(sid);
         for (size_t i = 0; i < ifstmt->false_statements.size(); i++) {
             analyze_node(ifstmt->false_statements[i]);
         }
-        m_stack.pop();
+        m_symtable->leave();
         ifstmt->false_scope_id = sid;
     }
 }
@@ -192,21 +205,19 @@ void analyzer::analyze_while_stmt(const ast::node_ptr &node)
 {
     auto whilestmt = ast::to_while_stmt(node);
 
-    auto curr_scope = m_stack.top();
+    auto curr_scope = m_symtable->current();
 
     analyze_node(whilestmt->eval_expr);
 
     if (!whilestmt->statements.empty()) {
-        int sid = get_next_scope();
         // cria o novo escopo para o escopo verdadeiro
-        auto fscope = std::make_shared<scope>(curr_scope, sid);
-        m_symtable->put_scope(sid, fscope);
+        int sid = m_symtable->new_scope(curr_scope);
         // empilha o escopo e insere os argumentos nele
-        m_stack.push(fscope);
+        m_symtable->enter(sid);
         for (size_t i = 0; i < whilestmt->statements.size(); i++) {
             analyze_node(whilestmt->statements[i]);
         }
-        m_stack.pop();
+        m_symtable->leave();
         whilestmt->scope_id = sid;
     }
 }
@@ -222,9 +233,9 @@ void analyzer::analyze_variable(const ast::node_ptr &node)
 {
     auto var = ast::to_variable(node);
 
-    auto curr_scope = m_stack.top();
-    if (!curr_scope->get(var->name).is_valid()) {
-        throw semantic_error(fmt::sprintf("Variavel %s nao declarada!", var->name));
+    compute_type(node);
+    if (var->sym == nullptr) {
+        throw semantic_error(fmt::sprintf("Variavel %s nao declarada!", name_of(var->name)));
     }
 }
 
@@ -246,13 +257,12 @@ void analyzer::analyze_call(const ast::node_ptr &node)
 {
     auto call = ast::to_call(node);
 
-    auto curr_scope = m_stack.top();
-    auto sym = curr_scope->get(call->name);
-    if (!sym.is_valid()) {
-        throw semantic_error(fmt::sprintf("Funcao %s nao declarada!", call->name));
+    compute_type(node);
+    if (call->sym == nullptr) {
+        throw semantic_error(fmt::sprintf("Funcao %s nao declarada!", name_of(call->name)));
     }
-    if (!(sym.type & types::function)) {
-        throw semantic_error(fmt::sprintf("Identificador %s nao e uma funcao!", call->name));
+    if (!(call->sym->type & types::function)) {
+        throw semantic_error(fmt::sprintf("Identificador %s nao e uma funcao!", name_of(call->name)));
     }
     // TODO: verificar quantidade de parametros
     for (size_t i = 0; i < call->param_list.size(); i++) {
@@ -264,12 +274,14 @@ void analyzer::analyze_op_arithm(const ast::node_ptr &node) {
     auto op = ast::to_op_arithm(node);
     analyze_node(op->left);
     analyze_node(op->right);
+    compute_type(node);
 }
 
 void analyzer::analyze_op_logical(const ast::node_ptr &node) {
     auto op = ast::to_op_logical(node);
     analyze_node(op->left);
     analyze_node(op->right);
+    compute_type(node);
 }
 
 void analyzer::analyze_program(const ast::node_ptr &node) {}
@@ -280,17 +292,16 @@ void analyzer::analyze_argument(const ast::node_ptr &node)
 {
     auto arg = ast::to_argument(node);
 
-    auto curr_scope = m_stack.top();
     int type = compute_type(arg->type_expr);
-    curr_scope->insert(arg->name, symbol(arg->name, type));
+    arg->sym = &m_symtable->insert(symbol(arg->name, type));
 }
 
 void analyzer::analyze_read_stmt(const ast::node_ptr &node)
 {
     auto read = ast::to_read_stmt(node);
-    auto curr_scope = m_stack.top();
-    if (!curr_scope->get(read->identifier).is_valid()) {
-        throw semantic_error(fmt::sprintf("Variavel %s nao declarada!", read->identifier));
+    read->sym = m_symtable->find(read->identifier);
+    if (read->sym == nullptr) {
+        throw semantic_error(fmt::sprintf("Variavel %s nao declarada!", name_of(read->identifier)));
     }
 }
 
@@ -300,23 +311,34 @@ void analyzer::analyze_write_stmt(const ast::node_ptr &node)
     analyze_node(write->expr);
 }
 
-// Computa os tipos
+// Computa o tipo de uma expressão e guarda no nó. Cada nó é calculado uma
+// única vez, mesmo que a expressão seja verificada por mais de um caminho.
 int analyzer::compute_type(const ast::node_ptr &expr)
+{
+    if (expr->eval_type == types::unknown) {
+        expr->eval_type = infer_type(expr);
+    }
+    return expr->eval_type;
+}
+
+int analyzer::infer_type(const ast::node_ptr &expr)
 {
     switch (expr->type) {
         case ast::call_node: {
-            auto curr_scope = m_stack.top();
-            auto sym = curr_scope->get(ast::to_call(expr)->name);
-            if (!sym.is_valid())
+            auto call = ast::to_call(expr);
+            if (call->sym == nullptr)
+                call->sym = m_symtable->find(call->name);
+            if (call->sym == nullptr)
                 return -1;
-            return sym.type & ~types::function;
+            return call->sym->type & ~types::function;
         }
         case ast::variable_node: {
-            auto curr_scope = m_stack.top();
-            auto sym = curr_scope->get(ast::to_variable(expr)->name);
-            if (!sym.is_valid())
+            auto var = ast::to_variable(expr);
+            if (var->sym == nullptr)
+                var->sym = m_symtable->find(var->name);
+            if (var->sym == nullptr)
                 return -1;
-            return sym.type;
+            return var->sym->type;
         }
         case ast::integer_node:
             return types::integer;
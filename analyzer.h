@@ -6,7 +6,6 @@
 
 #include <stdexcept>
 #include <string>
-#include <stack>
 #include "ast.h"
 #include "symtable.h"
 
@@ -26,7 +25,6 @@ public:
     symbol_table_ptr get_symtable();
 
 private:
-    int m_scope_counter;
     void analyze_node(const ast::node_ptr &node);
     void analyze_function_decl(const ast::node_ptr &node);
     void analyze_variable_decl(const ast::node_ptr &node);
@@ -48,10 +46,8 @@ private:
     void analyze_write_stmt(const ast::node_ptr &node);
 
     int compute_type(const ast::node_ptr &expr);
+    int infer_type(const ast::node_ptr &expr);
     symbol_table_ptr m_symtable;
-    int get_next_scope() { return m_scope_counter++; }
-    std::stack<scope_ptr> m_stack;
-    scope_ptr m_global;
 };
 
 }
@@ -0,0 +1,43 @@
+// -----------------------------------------------------------------------------
+// Pararatibum - A linguagem do momento
+// -----------------------------------------------------------------------------
+
+#include <cstdint>
+#include "arena.h"
+
+namespace ptb {
+
+arena::arena(size_t block_size) : m_block_size(block_size), m_cur(0), m_end(0),
+    m_reserved(0)
+{
+}
+
+arena::~arena()
+{
+    release();
+}
+
+void *arena::allocate_slow(size_t size, size_t align)
+{
+    // objetos maiores que um bloco ganham um bloco só para eles
+    size_t bytes = size + align > m_block_size ? size + align : m_block_size;
+    char *block = static_cast<char*>(::operator new(bytes));
+    m_blocks.push_back(block);
+    m_reserved += bytes;
+
+    m_cur = reinterpret_cast<uintptr_t>(block);
+    m_end = m_cur + bytes;
+    return allocate(size, align);
+}
+
+void arena::release()
+{
+    for (auto block : m_blocks) {
+        ::operator delete(block);
+    }
+    m_blocks.clear();
+    m_cur = m_end = 0;
+    m_reserved = 0;
+}
+
+}
@@ -0,0 +1,65 @@
+// -----------------------------------------------------------------------------
+// Pararatibum - A linguagem do momento
+// -----------------------------------------------------------------------------
+
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace ptb {
+
+// Alocador por avanço de ponteiro (bump allocator).
+//
+// A memória é pedida ao sistema em blocos grandes e cada alocação apenas
+// avança um ponteiro dentro do bloco atual. Nada é liberado
+// individualmente: todos os blocos são devolvidos de uma vez por release()
+// ou pelo destrutor, sem chamar destrutores dos objetos. Por isso só devem
+// ser criados aqui objetos trivialmente destrutíveis.
+class arena
+{
+public:
+    explicit arena(size_t block_size = 64 * 1024);
+    ~arena();
+
+    arena(const arena&) = delete;
+    arena& operator=(const arena&) = delete;
+
+    void *allocate(size_t size, size_t align = alignof(std::max_align_t)) {
+        size_t p = (m_cur + align - 1) & ~(align - 1);
+        if (p + size > m_end) {
+            return allocate_slow(size, align);
+        }
+        m_cur = p + size;
+        return reinterpret_cast<void*>(p);
+    }
+
+    template<typename T, typename...Args>
+    T *create(Args&&... args) {
+        return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+    }
+
+    template<typename T>
+    T *create_array(size_t count) {
+        return static_cast<T*>(allocate(sizeof(T) * count, alignof(T)));
+    }
+
+    // Libera todos os blocos de uma vez
+    void release();
+
+    // Total de bytes pedidos ao sistema
+    size_t reserved() const { return m_reserved; }
+
+private:
+    void *allocate_slow(size_t size, size_t align);
+
+    size_t m_block_size;
+    size_t m_cur;
+    size_t m_end;
+    size_t m_reserved;
+    std::vector<char*> m_blocks;
+};
+
+}
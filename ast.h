@@ -4,11 +4,18 @@
 
 #pragma once
 
-#include <vector>
 #include <string>
-#include <memory>
+#include <type_traits>
+#include "arena.h"
+#include "interner.h"
+#include "types.h"
 
-namespace ptb { namespace ast {
+namespace ptb {
+
+// declarado em symtable.h
+struct symbol;
+
+namespace ast {
 
 typedef enum {
     no_node = 0,
@@ -31,45 +38,88 @@ typedef enum {
     write_stmt_node,
 } ast_type;
 
+// Todos os nós de uma compilação são criados numa ptb::arena e liberados
+// junto com ela, então os nós não têm destrutor e são manipulados por
+// ponteiros simples. Os nomes de identificadores e os literais guardados
+// nos nós são ids da tabela global de nomes (ptb::names()). Os nós que
+// declaram ou usam um nome recebem do analisador semântico o símbolo
+// correspondente (campo sym), então as fases seguintes não buscam nomes.
+
 struct node {
     const ast_type type;
-    node(ast_type type_=no_node) : type(type_) { }
-    virtual ~node() {}
+    // tipo da expressão, calculado uma vez pelo analisador semântico
+    // (types::unknown até lá)
+    int eval_type;
+    node(ast_type type_=no_node) : type(type_), eval_type(types::unknown) { }
     bool is_valid() { return type != no_node; }
 };
 
 
-typedef std::unique_ptr<node> node_ptr;
+typedef node* node_ptr;
+
+// Nó vazio compartilhado, usado quando não há nada a construir (fim de uma
+// lista, declaração sem valor inicial...). Não é alocado na arena.
+inline node_ptr empty_node() {
+    static node none(no_node);
+    return &none;
+}
+
+// Lista de nós alocada na arena
+struct node_list {
+    node_ptr *items;
+    size_t count;
+
+    node_list() : items(nullptr), count(0) {}
+    node_list(node_ptr *items_, size_t count_) : items(items_), count(count_) {}
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    node_ptr& operator[](size_t i) const { return items[i]; }
+    node_ptr *begin() const { return items; }
+    node_ptr *end() const { return items + count; }
+};
+
+// Copia count nós para uma lista na arena
+inline node_list make_list(arena &a, const node_ptr *nodes, size_t count) {
+    if (count == 0) {
+        return node_list();
+    }
+    node_ptr *items = a.create_array<node_ptr>(count);
+    for (size_t i = 0; i < count; i++) {
+        items[i] = nodes[i];
+    }
+    return node_list(items, count);
+}
 
 
 struct program : node {
-    std::vector<node_ptr> declarations;
-    program(std::vector<node_ptr> decls) :
-        node(program_node), declarations(std::move(decls)) {
+    node_list declarations;
+    program(node_list decls) :
+        node(program_node), declarations(decls) {
     }
 };
 
 
 struct while_stmt : node {
     node_ptr eval_expr;
-    std::vector<node_ptr> statements;
+    node_list statements;
     int scope_id;
-    while_stmt(node_ptr cond_, std::vector<node_ptr> stmts) : node(while_stmt_node),
-        eval_expr(std::move(cond_)), statements(std::move(stmts)) {}
+    while_stmt(node_ptr cond_, node_list stmts) : node(while_stmt_node),
+        eval_expr(cond_), statements(stmts), scope_id(-1) {}
 };
 
 
 struct return_stmt : node {
     node_ptr expr;
     return_stmt(node_ptr expr_) : node(return_stmt_node),
-        expr(std::move(expr_)) {}
+        expr(expr_) {}
 };
 
 struct assign_stmt : node {
     node_ptr lvalue;
     node_ptr rvalue;
     assign_stmt(node_ptr lv, node_ptr rv) : node(assign_stmt_node),
-        lvalue(std::move(lv)), rvalue(std::move(rv)) {}
+        lvalue(lv), rvalue(rv) {}
 };
 
 
@@ -80,54 +130,59 @@ struct type : node {
 
 
 struct argument : node {
-    const std::string name;
+    name_id name;
     node_ptr type_expr;
-    argument(const std::string name_, node_ptr type_) : node(argument_node),
-        name(name_), type_expr(std::move(type_)) {}
+    symbol *sym;
+    argument(name_id name_, node_ptr type_) : node(argument_node),
+        name(name_), type_expr(type_), sym(nullptr) {}
 };
 
 struct variable : node {
-    const std::string name;
-    variable(const std::string& name_) : node(variable_node), name(name_) {
+    name_id name;
+    symbol *sym;
+    variable(name_id name_) : node(variable_node), name(name_), sym(nullptr) {
     }
 };
 
 struct variable_decl : node {
-    const std::string name;
+    name_id name;
     node_ptr type_expr;
     node_ptr value;
-    variable_decl(const std::string& name_, node_ptr type_, node_ptr value_) : node(variable_decl_node),
-        name(name_), type_expr(std::move(type_)), value(std::move(value_)) {
+    symbol *sym;
+    variable_decl(name_id name_, node_ptr type_, node_ptr value_) : node(variable_decl_node),
+        name(name_), type_expr(type_), value(value_), sym(nullptr) {
     }
 };
 
 
 struct function_decl : node {
-    const std::string name;
+    name_id name;
     node_ptr return_type;
-    std::vector<node_ptr> arguments;
-    std::vector<node_ptr> statements;
+    node_list arguments;
+    node_list statements;
     bool is_prototype;
+    symbol *sym;
     bool is_main() {
-        static const std::string m("@agora_eu_vou");
+        static const name_id m = names().intern("@agora_eu_vou");
         return name == m;
     }
 
-    function_decl(const std::string& name_, node_ptr rtype,
-        std::vector<node_ptr> args,
-        std::vector<node_ptr> stmts, bool isproto) :
-        node(function_decl_node), name(name_), return_type(std::move(rtype)),
-        arguments(std::move(args)), statements(std::move(stmts)), is_prototype(isproto) {
+    function_decl(name_id name_, node_ptr rtype,
+        node_list args,
+        node_list stmts, bool isproto) :
+        node(function_decl_node), name(name_), return_type(rtype),
+        arguments(args), statements(stmts), is_prototype(isproto), sym(nullptr) {
     }
 };
 
 
 struct call : node {
-    const std::string name;
-    std::vector<node_ptr> param_list;
+    name_id name;
+    node_list param_list;
     bool is_stmt;
-    call(const std::string& name_, std::vector<node_ptr> parlist, bool is_stmt_) :
-        node(call_node), name(name_), param_list(std::move(parlist)), is_stmt(is_stmt_) {
+    symbol *sym;
+    call(name_id name_, node_list parlist, bool is_stmt_) :
+        node(call_node), name(name_), param_list(parlist), is_stmt(is_stmt_), sym(nullptr) {
     }
 };
 
@@ -138,8 +193,8 @@ struct integer : node {
 };
 
 struct lstring : node {
-    const std::string value;
-    lstring(const std::string& str) : node(string_node), value(str) {}
+    name_id value;
+    lstring(name_id str) : node(string_node), value(str) {}
 };
 
 struct op_arithm : node {
@@ -148,7 +203,7 @@ struct op_arithm : node {
     node_ptr right;
     op_arithm(char op_, node_ptr lhs, node_ptr rhs) :
         node(op_arithm_node), op(op_),
-        left(std::move(lhs)), right(std::move(rhs)) {}
+        left(lhs), right(rhs) {}
 };
 
 struct op_logical : node {
@@ -157,43 +212,46 @@ struct op_logical : node {
     node_ptr right;
     op_logical(char op_, node_ptr lhs, node_ptr rhs) :
         node(op_logical_node), op(op_),
-        left(std::move(lhs)), right(std::move(rhs)) {}
+        left(lhs), right(rhs) {}
 };
 
 
 struct if_stmt : node {
     node_ptr eval_expr;
-    std::vector<node_ptr> true_statements;
-    std::vector<node_ptr> false_statements;
+    node_list true_statements;
+    node_list false_statements;
     int true_scope_id;
     int false_scope_id;
-    if_stmt(node_ptr eval, std::vector<node_ptr> truec, std::vector<node_ptr> falsec) :
-        node(if_stmt_node), eval_expr(std::move(eval)),
-        true_statements(std::move(truec)), false_statements(std::move(falsec)) {
+    if_stmt(node_ptr eval, node_list truec, node_list falsec) :
+        node(if_stmt_node), eval_expr(eval),
+        true_statements(truec), false_statements(falsec),
+        true_scope_id(-1), false_scope_id(-1) {
     }
 };
 
 struct read_stmt : node {
-    std::string identifier;
-    read_stmt(const std::string &str) : node(read_stmt_node), identifier(str) {}
+    name_id identifier;
+    symbol *sym;
+    read_stmt(name_id id) : node(read_stmt_node), identifier(id), sym(nullptr) {}
 };
 
 struct write_stmt : node {
     node_ptr expr;
-    write_stmt(node_ptr expr_) : node(write_stmt_node), expr(std::move(expr_)) {}
+    write_stmt(node_ptr expr_) : node(write_stmt_node), expr(expr_) {}
 };
 
 #define AST_MAKE_(name)                                                     \
+    static_assert(std::is_trivially_destructible<name>::value,              \
+                  #name " precisa ser trivialmente destrutivel");           \
     template<typename...Args>                                               \
-    inline node_ptr make_##name(Args&&... args) {                           \
-        return std::unique_ptr<name>(new name(std::forward<Args>(args)...));\
+    inline node_ptr make_##name(arena &a, Args&&... args) {                 \
+        return a.create<name>(std::forward<Args>(args)...);                 \
     }                                                                       \
     inline name* to_##name(const node_ptr &ptr) {                           \
-        return static_cast<name*>(ptr.get());                               \
+        return static_cast<name*>(ptr);                                     \
     }
 
 
-AST_MAKE_(node)
 AST_MAKE_(integer)
 AST_MAKE_(lstring)
 AST_MAKE_(if_stmt)
@@ -212,6 +270,34 @@ AST_MAKE_(argument)
 AST_MAKE_(variable_decl)
 AST_MAKE_(function_decl)
 
+// A expressão pode ser avaliada ou descartada sem mudar o comportamento do
+// programa: não chama funções e não divide por algo que pode ser zero. O
+// nó vazio (declaração sem valor inicial) também é puro.
+inline bool is_pure(const node_ptr &node)
+{
+    switch (node->type) {
+    case no_node:
+    case integer_node:
+    case string_node:
+    case variable_node:
+        return true;
+    case op_arithm_node: {
+        auto op = to_op_arithm(node);
+        if ((op->op == '/' || op->op == '%') &&
+            (op->right->type != integer_node || to_integer(op->right)->value == 0)) {
+            return false;
+        }
+        return is_pure(op->left) && is_pure(op->right);
+    }
+    case op_logical_node: {
+        auto op = to_op_logical(node);
+        return is_pure(op->left) && is_pure(op->right);
+    }
+    default:
+        return false;
+    }
+}
+
 
 } // ast
 } // ptb
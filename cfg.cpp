@@ -0,0 +1,56 @@
+// -----------------------------------------------------------------------------
+// Pararatibum - A linguagem do momento
+// -----------------------------------------------------------------------------
+
+#include <algorithm>
+#include "cfg.h"
+#include "timing.h"
+
+namespace ptb { namespace ir {
+
+void cfg::build(const function &func)
+{
+    scoped_timer timer("cfg");
+    size_t count = func.blocks.size();
+    m_succs.assign(count, std::vector<int32_t>());
+    m_preds.assign(count, std::vector<int32_t>());
+    for (size_t b = 0; b < count; b++) {
+        for_each_successor(func.blocks[b].terminator(), [&](int32_t s) {
+            m_succs[b].push_back(s);
+            m_preds[s].push_back(static_cast<int32_t>(b));
+        });
+    }
+
+    // busca em profundidade iterativa: a pilha guarda o bloco e o próximo
+    // sucessor a visitar
+    m_rpo.clear();
+    m_rpo_index.assign(count, -1);
+    if (count == 0) {
+        return;
+    }
+    std::vector<uint8_t> visited(count, 0);
+    std::vector<std::pair<int32_t, size_t>> stack;
+    visited[0] = 1;
+    stack.emplace_back(0, 0);
+    while (!stack.empty()) {
+        auto& top = stack.back();
+        const auto& succs = m_succs[top.first];
+        if (top.second < succs.size()) {
+            int32_t s = succs[top.second++];
+            if (!visited[s]) {
+                visited[s] = 1;
+                stack.emplace_back(s, 0);
+            }
+        } else {
+            m_rpo.push_back(top.first);
+            stack.pop_back();
+        }
+    }
+    std::reverse(m_rpo.begin(), m_rpo.end());
+    for (size_t i = 0; i < m_rpo.size(); i++) {
+        m_rpo_index[m_rpo[i]] = static_cast<int32_t>(i);
+    }
+}
+
+} // ir
+} // ptb
@@ -0,0 +1,37 @@
+// -----------------------------------------------------------------------------
+// Pararatibum - A linguagem do momento
+// -----------------------------------------------------------------------------
+
+#pragma once
+
+#include <vector>
+#include "ir.h"
+
+namespace ptb { namespace ir {
+
+// Grafo de fluxo de controle de uma função: os blocos da IR são os nós e
+// as arestas saem dos terminadores. Vale enquanto os blocos e os desvios
+// da função não mudarem.
+class cfg
+{
+public:
+    void build(const function &func);
+
+    size_t size() const { return m_succs.size(); }
+    const std::vector<int32_t>& succs(int32_t b) const { return m_succs[b]; }
+    const std::vector<int32_t>& preds(int32_t b) const { return m_preds[b]; }
+
+    // blocos alcançáveis a partir da entrada, em pós-ordem reversa (cada
+    // bloco antes dos seus sucessores, fora as arestas de volta dos laços)
+    const std::vector<int32_t>& reverse_postorder() const { return m_rpo; }
+    bool reachable(int32_t b) const { return m_rpo_index[b] >= 0; }
+
+private:
+    std::vector<std::vector<int32_t>> m_succs;
+    std::vector<std::vector<int32_t>> m_preds;
+    std::vector<int32_t> m_rpo;
+    std::vector<int32_t> m_rpo_index;
+};
+
+} // ir
+} // ptb
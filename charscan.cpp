@@ -0,0 +1,209 @@
+// -----------------------------------------------------------------------------
+// Pararatibum - A linguagem do momento
+// -----------------------------------------------------------------------------
+
+// Varredura do buffer de caractéres em blocos de 16 (SSE2) ou 32 (AVX2)
+// bytes, usada pelo analisador léxico para pular espaços, comentários e
+// o conteúdo de strings.
+
+#include <cstdint>
+#include <cstdlib>
+#include "charscan.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PTB_HAS_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined(PTB_HAS_SSE2) && defined(__GNUC__)
+#define PTB_HAS_AVX2
+#include <immintrin.h>
+#define PTB_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace ptb { namespace charscan {
+
+// Espaço em branco segundo std::isspace no locale "C"
+static inline bool is_space(char c)
+{
+    return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+// Índice do primeiro bit ligado de mask (mask != 0)
+static inline unsigned first_bit(unsigned mask)
+{
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return index;
+#else
+    return __builtin_ctz(mask);
+#endif
+}
+
+static const char *find_char_scalar(const char *p, char c)
+{
+    while (*p != c && *p != '\0')
+        p++;
+    return p;
+}
+
+static const char *skip_spaces_scalar(const char *p)
+{
+    while (is_space(*p))
+        p++;
+    return p;
+}
+
+#ifdef PTB_HAS_SSE2
+
+static const char *find_char_sse2(const char *p, char c)
+{
+    const __m128i needle = _mm_set1_epi8(c);
+    const __m128i zero = _mm_setzero_si128();
+
+    // o primeiro bloco é lido alinhado e os bytes antes de p são descartados
+    unsigned offset = reinterpret_cast<uintptr_t>(p) & 15;
+    const char *block = p - offset;
+    __m128i v = _mm_load_si128(reinterpret_cast<const __m128i *>(block));
+    unsigned mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, needle),
+                                                   _mm_cmpeq_epi8(v, zero)));
+    mask &= ~0u << offset;
+    while (mask == 0) {
+        block += 16;
+        v = _mm_load_si128(reinterpret_cast<const __m128i *>(block));
+        mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, needle),
+                                              _mm_cmpeq_epi8(v, zero)));
+    }
+    return block + first_bit(mask);
+}
+
+// Máscara com os bytes de v que não são espaço em branco
+static inline unsigned non_space_mask_sse2(__m128i v)
+{
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i tab_minus_1 = _mm_set1_epi8('\t' - 1);
+    const __m128i cr_plus_1 = _mm_set1_epi8('\r' + 1);
+    // comparação com sinal: bytes >= 0x80 ficam fora do intervalo \t..\r
+    __m128i ws = _mm_or_si128(_mm_cmpeq_epi8(v, space),
+                              _mm_and_si128(_mm_cmpgt_epi8(v, tab_minus_1),
+                                            _mm_cmplt_epi8(v, cr_plus_1)));
+    return ~_mm_movemask_epi8(ws) & 0xffff;
+}
+
+static const char *skip_spaces_sse2(const char *p)
+{
+    unsigned offset = reinterpret_cast<uintptr_t>(p) & 15;
+    const char *block = p - offset;
+    unsigned mask = non_space_mask_sse2(
+        _mm_load_si128(reinterpret_cast<const __m128i *>(block)));
+    mask &= ~0u << offset;
+    while (mask == 0) {
+        block += 16;
+        mask = non_space_mask_sse2(
+            _mm_load_si128(reinterpret_cast<const __m128i *>(block)));
+    }
+    return block + first_bit(mask);
+}
+
+#endif
+
+#ifdef PTB_HAS_AVX2
+
+PTB_TARGET_AVX2
+static const char *find_char_avx2(const char *p, char c)
+{
+    const __m256i needle = _mm256_set1_epi8(c);
+    const __m256i zero = _mm256_setzero_si256();
+
+    unsigned offset = reinterpret_cast<uintptr_t>(p) & 31;
+    const char *block = p - offset;
+    __m256i v = _mm256_load_si256(reinterpret_cast<const __m256i *>(block));
+    unsigned mask = _mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(v, needle),
+                                                         _mm256_cmpeq_epi8(v, zero)));
+    mask &= ~0u << offset;
+    while (mask == 0) {
+        block += 32;
+        v = _mm256_load_si256(reinterpret_cast<const __m256i *>(block));
+        mask = _mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(v, needle),
+                                                    _mm256_cmpeq_epi8(v, zero)));
+    }
+    return block + first_bit(mask);
+}
+
+PTB_TARGET_AVX2
+static inline unsigned non_space_mask_avx2(__m256i v)
+{
+    const __m256i space = _mm256_set1_epi8(' ');
+    const __m256i tab_minus_1 = _mm256_set1_epi8('\t' - 1);
+    const __m256i cr_plus_1 = _mm256_set1_epi8('\r' + 1);
+    __m256i ws = _mm256_or_si256(_mm256_cmpeq_epi8(v, space),
+                                 _mm256_and_si256(_mm256_cmpgt_epi8(v, tab_minus_1),
+                                                  _mm256_cmpgt_epi8(cr_plus_1, v)));
+    return ~static_cast<unsigned>(_mm256_movemask_epi8(ws));
+}
+
+PTB_TARGET_AVX2
+static const char *skip_spaces_avx2(const char *p)
+{
+    unsigned offset = reinterpret_cast<uintptr_t>(p) & 31;
+    const char *block = p - offset;
+    unsigned mask = non_space_mask_avx2(
+        _mm256_load_si256(reinterpret_cast<const __m256i *>(block)));
+    mask &= ~0u << offset;
+    while (mask == 0) {
+        block += 32;
+        mask = non_space_mask_avx2(
+            _mm256_load_si256(reinterpret_cast<const __m256i *>(block)));
+    }
+    return block + first_bit(mask);
+}
+
+#endif
+
+struct scanner {
+    const char *(*find_char)(const char *, char);
+    const char *(*skip_spaces)(const char *);
+    const char *name;
+};
+
+// A variável de ambiente PTB_NO_SIMD força a implementação escalar
+static scanner select_scanner()
+{
+    if (std::getenv("PTB_NO_SIMD"))
+        return { find_char_scalar, skip_spaces_scalar, "escalar" };
+#ifdef PTB_HAS_AVX2
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return { find_char_avx2, skip_spaces_avx2, "avx2" };
+#endif
+#ifdef PTB_HAS_SSE2
+    return { find_char_sse2, skip_spaces_sse2, "sse2" };
+#else
+    return { find_char_scalar, skip_spaces_scalar, "escalar" };
+#endif
+}
+
+static const scanner impl = select_scanner();
+
+const char *find_char(const char *p, char c)
+{
+    return impl.find_char(p, c);
+}
+
+const char *skip_spaces(const char *p)
+{
+    return impl.skip_spaces(p);
+}
+
+const char *implementation()
+{
+    return impl.name;
+}
+
+} // charscan
+} // ptb
@@ -0,0 +1,33 @@
+// -----------------------------------------------------------------------------
+// Pararatibum - A linguagem do momento
+// -----------------------------------------------------------------------------
+
+#pragma once
+
+#include <cstddef>
+
+namespace ptb { namespace charscan {
+
+// Varredura rápida do buffer de caractéres do analisador léxico.
+//
+// As funções assumem que o buffer termina com um '\0' sentinela e param nele.
+// As versões SSE2/AVX2 leem blocos alinhados de 16/32 bytes, que nunca
+// atravessam o limite de uma página, então podem passar do sentinela sem
+// risco. Para buffers alocados pelo analisador é deixado um preenchimento
+// de `padding` bytes depois do sentinela.
+// A implementação (AVX2, SSE2 ou escalar) é escolhida em tempo de execução,
+// PTB_NO_SIMD no ambiente força a versão escalar.
+
+const size_t padding = 32;
+
+// Primeira posição a partir de p com o caractér c ou '\0'
+const char *find_char(const char *p, char c);
+
+// Primeira posição a partir de p que não é espaço em branco
+const char *skip_spaces(const char *p);
+
+// Nome da implementação em uso
+const char *implementation();
+
+} // charscan
+} // ptb
@@ -0,0 +1,785 @@
+// -----------------------------------------------------------------------------
+// Pararatibum - A linguagem do momento
+// -----------------------------------------------------------------------------
+
+// Formato do arquivo .class: The Java Virtual Machine Specification,
+// capítulo 4. Os métodos são verificados pela StackMapTable, que guarda o
+// tipo das variáveis locais e da pilha no destino de cada desvio.
+
+#include <algorithm>
+#include <cppfmt/format.h>
+#include "classfile.h"
+
+namespace ptb { namespace jvm {
+
+enum constant_tag : uint8_t {
+    const_utf8 = 1,
+    const_integer = 3,
+    const_class = 7,
+    const_string = 8,
+    const_fieldref = 9,
+    const_methodref = 10,
+    const_name_and_type = 12,
+};
+
+// versão 50 (Java 6), a primeira que usa a StackMapTable
+static const uint16_t class_major_version = 50;
+
+// Texto em UTF-8 para o "UTF-8 modificado" do constant pool: o caractere
+// nulo usa dois bytes e os caracteres fora do plano básico viram dois
+// substitutos (surrogates). Bytes que não formam UTF-8 válido são tratados
+// como Latin-1.
+static std::string modified_utf8(const std::string &text)
+{
+    std::string out;
+    auto put = [&](uint32_t cp) {
+        if (cp != 0 && cp < 0x80) {
+            out += static_cast<char>(cp);
+        } else if (cp < 0x800) {
+            out += static_cast<char>(0xc0 | (cp >> 6));
+            out += static_cast<char>(0x80 | (cp & 0x3f));
+        } else {
+            out += static_cast<char>(0xe0 | (cp >> 12));
+            out += static_cast<char>(0x80 | ((cp >> 6) & 0x3f));
+            out += static_cast<char>(0x80 | (cp & 0x3f));
+        }
+    };
+    size_t i = 0;
+    while (i < text.size()) {
+        auto c = static_cast<uint8_t>(text[i]);
+        size_t len = c >= 0xf0 ? 4 : c >= 0xe0 ? 3 : c >= 0xc0 ? 2 : 1;
+        uint32_t cp = len == 1 ? c : c & (0x7f >> len);
+        bool valid = c < 0x80 || (c >= 0xc2 && c <= 0xf4 && i + len <= text.size());
+        for (size_t k = 1; valid && k < len; k++) {
+            auto cont = static_cast<uint8_t>(text[i + k]);
+            valid = (cont & 0xc0) == 0x80;
+            cp = (cp << 6) | (cont & 0x3f);
+        }
+        if (!valid) {
+            put(c);
+            i++;
+            continue;
+        }
+        if (cp >= 0x10000) {
+            cp -= 0x10000;
+            put(0xd800 + (cp >> 10));
+            put(0xdc00 + (cp & 0x3ff));
+        } else {
+            put(cp);
+        }
+        i += len;
+    }
+    return out;
+}
+
+std::string unescape_literal(const std::string &literal)
+{
+    size_t begin = 0, end = literal.size();
+    if (end >= 2 && literal[0] == '"' && literal[end - 1] == '"') {
+        begin++;
+        end--;
+    }
+    std::string value;
+    for (size_t i = begin; i < end; i++) {
+        if (literal[i] != '\\' || i + 1 == end) {
+            value += literal[i];
+            continue;
+        }
+        switch (literal[++i]) {
+        case 'n': value += '\n'; break;
+        case 't': value += '\t'; break;
+        case 'r': value += '\r'; break;
+        case 'b': value += '\b'; break;
+        case 'f': value += '\f'; break;
+        case '0': value += '\0'; break;
+        default: value += literal[i]; break;
+        }
+    }
+    return value;
+}
+
+class_writer::class_writer(const std::string &name, const std::string &super) :
+    m_pool_count(1), m_field_count(0), m_method_count(0)
+{
+    m_this = class_ref(name);
+    m_super = class_ref(super);
+}
+
+uint16_t class_writer::constant(const std::string &key, const byte_buffer &entry)
+{
+    auto it = m_pool_index.find(key);
+    if (it != m_pool_index.end()) {
+        return it->second;
+    }
+    if (m_pool_count == 0xffff) {
+        throw jvmasm_error("Constant pool cheio");
+    }
+    m_pool.append(entry);
+    m_pool_index.emplace(key, m_pool_count);
+    return m_pool_count++;
+}
+
+uint16_t class_writer::utf8(const std::string &text)
+{
+    std::string bytes = modified_utf8(text);
+    if (bytes.size() > 0xffff) {
+        throw jvmasm_error("String grande demais para o arquivo .class");
+    }
+    byte_buffer entry;
+    entry.u1(const_utf8);
+    entry.u2(static_cast<uint32_t>(bytes.size()));
+    for (auto c : bytes) {
+        entry.u1(static_cast<uint8_t>(c));
+    }
+    return constant(std::string(1, const_utf8) + text, entry);
+}
+
+uint16_t class_writer::class_ref(const std::string &name)
+{
+    byte_buffer entry;
+    entry.u1(const_class);
+    entry.u2(utf8(name));
+    return constant(std::string(1, const_class) + name, entry);
+}
+
+uint16_t class_writer::string_ref(const std::string &text)
+{
+    byte_buffer entry;
+    entry.u1(const_string);
+    entry.u2(utf8(text));
+    return constant(std::string(1, const_string) + text, entry);
+}
+
+uint16_t class_writer::integer_ref(int32_t value)
+{
+    byte_buffer entry;
+    entry.u1(const_integer);
+    entry.u4(static_cast<uint32_t>(value));
+    return constant(std::string(1, const_integer) + std::to_string(value), entry);
+}
+
+uint16_t class_writer::name_and_type(const std::string &name, const std::string &desc)
+{
+    byte_buffer entry;
+    entry.u1(const_name_and_type);
+    entry.u2(utf8(name));
+    entry.u2(utf8(desc));
+    return constant(std::string(1, const_name_and_type) + name + " " + desc, entry);
+}
+
+uint16_t class_writer::member_ref(uint8_t tag, const insn &ins)
+{
+    byte_buffer entry;
+    entry.u1(tag);
+    entry.u2(class_ref(ins.owner));
+    entry.u2(name_and_type(ins.name, ins.desc));
+    return constant(std::string(1, tag) + ins.owner + "." + ins.name + " " + ins.desc, entry);
+}
+
+void class_writer::add_field(uint16_t access, const std::string &name, const std::string &desc)
+{
+    m_fields.u2(access);
+    m_fields.u2(utf8(name));
+    m_fields.u2(utf8(desc));
+    m_fields.u2(0);
+    m_field_count++;
+}
+
+// Tipo do valor descrito a partir de desc[pos]
+verification_type class_writer::type_of(const std::string &desc, size_t pos)
+{
+    switch (desc[pos]) {
+    case 'L': {
+        size_t end = desc.find(';', pos);
+        return verification_type{verification_type::object,
+                                 class_ref(desc.substr(pos + 1, end - pos - 1))};
+    }
+    case '[': {
+        // o nome da classe de um vetor é o próprio descritor
+        size_t end = pos;
+        while (desc[end] == '[') {
+            end++;
+        }
+        end = desc[end] == 'L' ? desc.find(';', end) + 1 : end + 1;
+        return verification_type{verification_type::object,
+                                 class_ref(desc.substr(pos, end - pos))};
+    }
+    default:
+        // boolean, char e int são todos int para o verificador
+        return verification_type{verification_type::integer, 0};
+    }
+}
+
+class_writer::frame class_writer::initial_frame(uint16_t access, const std::string &name,
+                                                const std::string &desc, int max_locals)
+{
+    frame f;
+    f.locals.assign(max_locals, verification_type{verification_type::top, 0});
+    size_t slot = 0;
+    if (!(access & acc_static)) {
+        f.locals.at(slot++) = name == "<init>" ?
+            verification_type{verification_type::uninitialized_this, 0} :
+            verification_type{verification_type::object, m_this};
+    }
+    for (size_t pos = 1; desc[pos] != ')'; pos++) {
+        f.locals.at(slot++) = type_of(desc, pos);
+        while (desc[pos] == '[') {
+            pos++;
+        }
+        if (desc[pos] == 'L') {
+            pos = desc.find(';', pos);
+        }
+    }
+    return f;
+}
+
+// Aplica o efeito da instrução sobre os tipos da pilha e das variáveis
+void class_writer::execute(const insn &ins, size_t index, frame &f)
+{
+    auto pop = [&]() {
+        if (f.stack.empty()) {
+            throw jvmasm_error(fmt::sprintf(
+                "Pilha vazia na instrucao %d (%s)", index, mnemonic(ins.op)));
+        }
+        auto type = f.stack.back();
+        f.stack.pop_back();
+        return type;
+    };
+    auto local = [&](int32_t slot) -> verification_type& {
+        if (slot < 0 || static_cast<size_t>(slot) >= f.locals.size()) {
+            throw jvmasm_error(fmt::sprintf("Variavel local %d fora do limite", slot));
+        }
+        return f.locals[slot];
+    };
+    const verification_type integer{verification_type::integer, 0};
+
+    switch (ins.op) {
+    case op_label:
+    case op_iinc:
+    case op_goto:
+    case op_return:
+        break;
+    case op_iconst:
+        f.stack.push_back(integer);
+        break;
+    case op_ldc_string:
+        f.stack.push_back(verification_type{verification_type::object,
+                                            class_ref("java/lang/String")});
+        break;
+    case op_iload:
+        local(ins.arg);
+        f.stack.push_back(integer);
+        break;
+    case op_aload: {
+        auto type = local(ins.arg);
+        if (type.tag == verification_type::top) {
+            throw jvmasm_error(fmt::sprintf(
+                "Variavel local %d lida antes de ser escrita", ins.arg));
+        }
+        f.stack.push_back(type);
+        break;
+    }
+    case op_istore:
+        pop();
+        local(ins.arg) = integer;
+        break;
+    case op_astore: {
+        auto type = pop();
+        local(ins.arg) = type;
+        break;
+    }
+    case op_iadd:
+    case op_isub:
+    case op_imul:
+    case op_idiv:
+    case op_irem:
+    case op_iand:
+    case op_ior:
+        pop();
+        pop();
+        f.stack.push_back(integer);
+        break;
+    case op_ifeq:
+    case op_ifne:
+    case op_putstatic:
+    case op_pop:
+    case op_ireturn:
+    case op_areturn:
+        pop();
+        break;
+    case op_if_icmpeq:
+    case op_if_icmpne:
+    case op_if_icmplt:
+    case op_if_icmple:
+    case op_if_icmpgt:
+    case op_if_icmpge:
+        pop();
+        pop();
+        break;
+    case op_getstatic:
+        f.stack.push_back(type_of(ins.desc, 0));
+        break;
+    case op_invokestatic:
+    case op_invokevirtual:
+    case op_invokespecial: {
+        int args;
+        bool returns;
+        describe_method(ins.desc, args, returns);
+        for (int k = 0; k < args; k++) {
+            pop();
+        }
+        if (ins.op != op_invokestatic) {
+            auto receiver = pop();
+            bool constructor = ins.op == op_invokespecial && ins.name == "<init>" &&
+                (receiver.tag == verification_type::uninitialized ||
+                 receiver.tag == verification_type::uninitialized_this);
+            if (constructor) {
+                // depois do construtor todas as cópias do objeto estão
+                // inicializadas
+                verification_type ready{verification_type::object,
+                    receiver.tag == verification_type::uninitialized_this ?
+                    m_this : class_ref(ins.owner)};
+                for (auto& t : f.stack) {
+                    t = t == receiver ? ready : t;
+                }
+                for (auto& t : f.locals) {
+                    t = t == receiver ? ready : t;
+                }
+            }
+        }
+        if (returns) {
+            f.stack.push_back(type_of(ins.desc, ins.desc.find(')') + 1));
+        }
+        break;
+    }
+    case op_new:
+        f.stack.push_back(verification_type{verification_type::uninitialized,
+                                            static_cast<uint32_t>(index)});
+        break;
+    case op_dup: {
+        auto type = pop();
+        f.stack.push_back(type);
+        f.stack.push_back(type);
+        break;
+    }
+    }
+}
+
+// Combina os tipos que chegam por outro caminho: uma variável com tipos
+// diferentes não pode mais ser lida (top); a pilha precisa ser igual
+void class_writer::merge(frame &into, const frame &from, bool &changed)
+{
+    for (size_t k = 0; k < into.locals.size(); k++) {
+        if (into.locals[k] != from.locals[k] &&
+            into.locals[k].tag != verification_type::top) {
+            into.locals[k] = verification_type{verification_type::top, 0};
+            changed = true;
+        }
+    }
+    if (into.stack != from.stack) {
+        throw jvmasm_error("Pilha com tamanho ou tipos diferentes num destino de desvio");
+    }
+}
+
+// Calcula os tipos no início de cada rótulo alcançável, percorrendo o
+// código a partir da entrada até que nenhum rótulo mude
+void class_writer::infer_frames(const std::vector<insn> &code, const frame &entry,
+                                std::vector<frame> &states, std::vector<uint8_t> &reached,
+                                int &max_stack)
+{
+    std::vector<int32_t> labels;
+    for (size_t i = 0; i < code.size(); i++) {
+        if (code[i].op == op_label) {
+            auto label = static_cast<size_t>(code[i].arg);
+            if (label >= labels.size()) {
+                labels.resize(label + 1, -1);
+            }
+            labels[label] = static_cast<int32_t>(i);
+        }
+    }
+
+    states.assign(code.size(), frame());
+    reached.assign(code.size(), 0);
+    std::vector<uint8_t> known(code.size(), 0);
+    std::vector<size_t> work;
+    max_stack = 0;
+    // devolve true se o estado no início de i mudou
+    auto arrive = [&](size_t i, const frame &f) {
+        if (!known[i]) {
+            known[i] = 1;
+            states[i] = f;
+            return true;
+        }
+        bool changed = false;
+        merge(states[i], f, changed);
+        return changed;
+    };
+
+    if (code.empty()) {
+        return;
+    }
+    arrive(0, entry);
+    work.push_back(0);
+    frame current;
+    while (!work.empty()) {
+        size_t i = work.back();
+        work.pop_back();
+        current = states[i];
+        while (true) {
+            reached[i] = 1;
+            const auto& ins = code[i];
+            execute(ins, i, current);
+            max_stack = std::max(max_stack, static_cast<int>(current.stack.size()));
+            if (ins.is_branch()) {
+                auto label = static_cast<size_t>(ins.arg);
+                if (label >= labels.size() || labels[label] < 0) {
+                    throw jvmasm_error(fmt::sprintf("Rotulo L%d nao definido", ins.arg));
+                }
+                if (arrive(labels[label], current)) {
+                    work.push_back(labels[label]);
+                }
+            }
+            if (ins.ends_flow() || ++i == code.size()) {
+                break;
+            }
+            if (code[i].op == op_label) {
+                // segue adiante só se o rótulo ainda não tinha esse estado
+                if (!arrive(i, current)) {
+                    break;
+                }
+                current = states[i];
+            }
+        }
+    }
+}
+
+size_t class_writer::encoded_size(const insn &ins)
+{
+    switch (ins.op) {
+    case op_label:
+        return 0;
+    case op_iconst:
+        if (ins.arg >= -1 && ins.arg <= 5) {
+            return 1;
+        }
+        if (ins.arg >= -128 && ins.arg <= 127) {
+            return 2;
+        }
+        if (ins.arg >= -32768 && ins.arg <= 32767) {
+            return 3;
+        }
+        return integer_ref(ins.arg) < 256 ? 2 : 3;
+    case op_ldc_string:
+        return string_ref(unescape_literal(ins.name)) < 256 ? 2 : 3;
+    case op_iload:
+    case op_istore:
+    case op_aload:
+    case op_astore:
+        return ins.arg <= 3 ? 1 : ins.arg <= 255 ? 2 : 4;
+    case op_iinc:
+        return ins.arg <= 255 && ins.arg2 >= -128 && ins.arg2 <= 127 ? 3 : 6;
+    case op_ifeq:
+    case op_ifne:
+    case op_if_icmpeq:
+    case op_if_icmpne:
+    case op_if_icmplt:
+    case op_if_icmple:
+    case op_if_icmpgt:
+    case op_if_icmpge:
+    case op_goto:
+    case op_getstatic:
+    case op_putstatic:
+    case op_invokestatic:
+    case op_invokevirtual:
+    case op_invokespecial:
+    case op_new:
+        return 3;
+    default:
+        return 1;
+    }
+}
+
+void class_writer::encode(const insn &ins, size_t offset, const std::vector<int32_t> &labels,
+                          byte_buffer &out)
+{
+    // instrução com a variável local como operando; as quatro primeiras
+    // têm formas de um byte
+    auto local_op = [&](uint8_t op, uint8_t short_op) {
+        if (ins.arg <= 3) {
+            out.u1(short_op + ins.arg);
+        } else if (ins.arg <= 255) {
+            out.u1(op);
+            out.u1(ins.arg);
+        } else {
+            out.u1(0xc4);   // wide
+            out.u1(op);
+            out.u2(ins.arg);
+        }
+    };
+    auto branch_op = [&](uint8_t op) {
+        int32_t delta = labels[ins.arg] - static_cast<int32_t>(offset);
+        if (delta < -32768 || delta > 32767) {
+            throw jvmasm_error("Metodo grande demais: desvio fora do alcance");
+        }
+        out.u1(op);
+        out.u2(static_cast<uint16_t>(delta));
+    };
+    auto ldc = [&](uint16_t index) {
+        if (index < 256) {
+            out.u1(0x12);
+            out.u1(index);
+        } else {
+            out.u1(0x13);   // ldc_w
+            out.u2(index);
+        }
+    };
+
+    switch (ins.op) {
+    case op_label:
+        break;
+    case op_iconst:
+        if (ins.arg >= -1 && ins.arg <= 5) {
+            out.u1(0x03 + ins.arg);     // iconst_<n>
+        } else if (ins.arg >= -128 && ins.arg <= 127) {
+            out.u1(0x10);               // bipush
+            out.u1(static_cast<uint8_t>(ins.arg));
+        } else if (ins.arg >= -32768 && ins.arg <= 32767) {
+            out.u1(0x11);               // sipush
+            out.u2(static_cast<uint16_t>(ins.arg));
+        } else {
+            ldc(integer_ref(ins.arg));
+        }
+        break;
+    case op_ldc_string: ldc(string_ref(unescape_literal(ins.name))); break;
+    case op_iload: local_op(0x15, 0x1a); break;
+    case op_aload: local_op(0x19, 0x2a); break;
+    case op_istore: local_op(0x36, 0x3b); break;
+    case op_astore: local_op(0x3a, 0x4b); break;
+    case op_iinc:
+        if (ins.arg <= 255 && ins.arg2 >= -128 && ins.arg2 <= 127) {
+            out.u1(0x84);
+            out.u1(ins.arg);
+            out.u1(static_cast<uint8_t>(ins.arg2));
+        } else {
+            out.u1(0xc4);
+            out.u1(0x84);
+            out.u2(ins.arg);
+            out.u2(static_cast<uint16_t>(ins.arg2));
+        }
+        break;
+    case op_iadd: out.u1(0x60); break;
+    case op_isub: out.u1(0x64); break;
+    case op_imul: out.u1(0x68); break;
+    case op_idiv: out.u1(0x6c); break;
+    case op_irem: out.u1(0x70); break;
+    case op_iand: out.u1(0x7e); break;
+    case op_ior: out.u1(0x80); break;
+    case op_ifeq: branch_op(0x99); break;
+    case op_ifne: branch_op(0x9a); break;
+    case op_if_icmpeq: branch_op(0x9f); break;
+    case op_if_icmpne: branch_op(0xa0); break;
+    case op_if_icmplt: branch_op(0xa1); break;
+    case op_if_icmpge: branch_op(0xa2); break;
+    case op_if_icmpgt: branch_op(0xa3); break;
+    case op_if_icmple: branch_op(0xa4); break;
+    case op_goto: branch_op(0xa7); break;
+    case op_getstatic: out.u1(0xb2); out.u2(member_ref(const_fieldref, ins)); break;
+    case op_putstatic: out.u1(0xb3); out.u2(member_ref(const_fieldref, ins)); break;
+    case op_invokevirtual: out.u1(0xb6); out.u2(member_ref(const_methodref, ins)); break;
+    case op_invokespecial: out.u1(0xb7); out.u2(member_ref(const_methodref, ins)); break;
+    case op_invokestatic: out.u1(0xb8); out.u2(member_ref(const_methodref, ins)); break;
+    case op_new: out.u1(0xbb); out.u2(class_ref(ins.owner)); break;
+    case op_dup: out.u1(0x59); break;
+    case op_pop: out.u1(0x57); break;
+    case op_ireturn: out.u1(0xac); break;
+    case op_areturn: out.u1(0xb0); break;
+    case op_return: out.u1(0xb1); break;
+    }
+}
+
+void class_writer::write_type(const verification_type &type, byte_buffer &out)
+{
+    out.u1(type.tag);
+    if (type.tag == verification_type::object) {
+        out.u2(type.index);
+    } else if (type.tag == verification_type::uninitialized) {
+        // não acontece no código gerado: o objeto criado por new é
+        // inicializado antes de qualquer desvio
+        throw jvmasm_error("Objeto nao inicializado num destino de desvio");
+    }
+}
+
+// Grava os quadros da StackMapTable. Cada quadro é relativo ao anterior,
+// e o primeiro ao quadro implícito da entrada do método; quando as
+// variáveis não mudam usa as formas curtas.
+void class_writer::write_frames(const std::vector<std::pair<uint32_t, const frame*>> &frames,
+                                const frame &entry, byte_buffer &out)
+{
+    // variáveis sem tipo no fim não precisam ser listadas
+    auto trimmed = [](const std::vector<verification_type> &locals) {
+        size_t count = locals.size();
+        while (count > 0 && locals[count - 1].tag == verification_type::top) {
+            count--;
+        }
+        return std::vector<verification_type>(locals.begin(), locals.begin() + count);
+    };
+
+    out.u2(utf8("StackMapTable"));
+    size_t length_pos = out.size();
+    out.u4(0);
+    size_t start = out.size();
+    out.u2(static_cast<uint32_t>(frames.size()));
+    auto previous = trimmed(entry.locals);
+    int64_t previous_pc = -1;
+    for (const auto& item : frames) {
+        auto locals = trimmed(item.second->locals);
+        const auto& stack = item.second->stack;
+        uint32_t delta = static_cast<uint32_t>(item.first - previous_pc - 1);
+        if (locals == previous && stack.empty()) {
+            if (delta < 64) {
+                out.u1(delta);                  // same_frame
+            } else {
+                out.u1(251);                    // same_frame_extended
+                out.u2(delta);
+            }
+        } else if (locals == previous && stack.size() == 1) {
+            if (delta < 64) {
+                out.u1(64 + delta);             // same_locals_1_stack_item
+            } else {
+                out.u1(247);
+                out.u2(delta);
+            }
+            write_type(stack[0], out);
+        } else {
+            out.u1(255);                        // full_frame
+            out.u2(delta);
+            out.u2(static_cast<uint32_t>(locals.size()));
+            for (const auto& t : locals) {
+                write_type(t, out);
+            }
+            out.u2(static_cast<uint32_t>(stack.size()));
+            for (const auto& t : stack) {
+                write_type(t, out);
+            }
+        }
+        previous = locals;
+        previous_pc = item.first;
+    }
+    uint32_t length = static_cast<uint32_t>(out.size() - start);
+    out.patch_u2(length_pos, length >> 16);
+    out.patch_u2(length_pos + 2, length & 0xffff);
+}
+
+void class_writer::add_method(uint16_t access, const std::string &name, const std::string &desc,
+                              int max_locals, const method_code &method)
+{
+    const auto& code = method.code();
+    frame entry = initial_frame(access, name, desc, max_locals);
+    std::vector<frame> states;
+    std::vector<uint8_t> reached;
+    int max_stack;
+    infer_frames(code, entry, states, reached, max_stack);
+
+    // endereço de cada rótulo; o código inalcançável não é gravado, já
+    // que o verificador exigiria um quadro para ele
+    std::vector<int32_t> labels;
+    std::vector<uint8_t> targeted;
+    uint32_t pc = 0;
+    for (size_t i = 0; i < code.size(); i++) {
+        if (!reached[i]) {
+            continue;
+        }
+        if (code[i].op == op_label) {
+            auto label = static_cast<size_t>(code[i].arg);
+            if (label >= labels.size()) {
+                labels.resize(label + 1, -1);
+                targeted.resize(label + 1, 0);
+            }
+            labels[label] = static_cast<int32_t>(pc);
+        } else if (code[i].is_branch()) {
+            auto label = static_cast<size_t>(code[i].arg);
+            if (label >= targeted.size()) {
+                labels.resize(label + 1, -1);
+                targeted.resize(label + 1, 0);
+            }
+            targeted[label] = 1;
+        }
+        pc += static_cast<uint32_t>(encoded_size(code[i]));
+    }
+    if (pc >= 65536) {
+        throw jvmasm_error(fmt::sprintf("Metodo %s grande demais: %d bytes", name, pc));
+    }
+
+    byte_buffer bytecode;
+    // quadros nos destinos dos desvios e depois de cada desvio
+    // incondicional; rótulos seguidos dividem o mesmo endereço e ficam
+    // com o estado do último, que já inclui os anteriores
+    std::vector<std::pair<uint32_t, const frame*>> frames;
+    bool after_jump = false;
+    for (size_t i = 0; i < code.size(); i++) {
+        if (!reached[i]) {
+            continue;
+        }
+        const auto& ins = code[i];
+        auto offset = static_cast<uint32_t>(bytecode.size());
+        if (ins.op == op_label) {
+            bool same_pc = !frames.empty() && frames.back().first == offset;
+            if (targeted[ins.arg] || after_jump || same_pc) {
+                if (same_pc) {
+                    frames.back().second = &states[i];
+                } else {
+                    frames.emplace_back(offset, &states[i]);
+                }
+            }
+            continue;
+        }
+        encode(ins, offset, labels, bytecode);
+        after_jump = ins.ends_flow();
+    }
+
+    byte_buffer attributes;
+    uint16_t attribute_count = 0;
+    if (!frames.empty()) {
+        write_frames(frames, entry, attributes);
+        attribute_count++;
+    }
+
+    m_methods.u2(access);
+    m_methods.u2(utf8(name));
+    m_methods.u2(utf8(desc));
+    m_methods.u2(1);
+    m_methods.u2(utf8("Code"));
+    m_methods.u4(static_cast<uint32_t>(12 + bytecode.size() + attributes.size()));
+    m_methods.u2(static_cast<uint32_t>(max_stack));
+    m_methods.u2(static_cast<uint32_t>(max_locals));
+    m_methods.u4(static_cast<uint32_t>(bytecode.size()));
+    m_methods.append(bytecode);
+    m_methods.u2(0);    // tabela de exceções
+    m_methods.u2(attribute_count);
+    m_methods.append(attributes);
+    m_method_count++;
+}
+
+void class_writer::write(std::ostream &out) const
+{
+    byte_buffer file;
+    file.u4(0xcafebabe);
+    file.u2(0);
+    file.u2(class_major_version);
+    file.u2(m_pool_count);
+    file.append(m_pool);
+    file.u2(acc_public | acc_super);
+    file.u2(m_this);
+    file.u2(m_super);
+    file.u2(0);     // interfaces
+    file.u2(m_field_count);
+    file.append(m_fields);
+    file.u2(m_method_count);
+    file.append(m_methods);
+    file.u2(0);     // atributos
+    out.write(reinterpret_cast<const char*>(file.data().data()),
+              static_cast<std::streamsize>(file.size()));
+}
+
+} // jvm
+} // ptb
@@ -0,0 +1,129 @@
+// -----------------------------------------------------------------------------
+// Pararatibum - A linguagem do momento
+// -----------------------------------------------------------------------------
+
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "jvmasm.h"
+
+namespace ptb { namespace jvm {
+
+enum access_flags : uint16_t {
+    acc_public = 0x0001,
+    acc_static = 0x0008,
+    acc_super = 0x0020,
+};
+
+// Buffer de bytes em big-endian, a ordem usada no arquivo .class
+class byte_buffer
+{
+public:
+    void u1(uint32_t v) { m_data.push_back(static_cast<uint8_t>(v)); }
+    void u2(uint32_t v) { u1(v >> 8); u1(v); }
+    void u4(uint32_t v) { u2(v >> 16); u2(v); }
+    void append(const byte_buffer &other) {
+        m_data.insert(m_data.end(), other.m_data.begin(), other.m_data.end());
+    }
+    // sobrescreve dois bytes já gravados
+    void patch_u2(size_t pos, uint32_t v) {
+        m_data[pos] = static_cast<uint8_t>(v >> 8);
+        m_data[pos + 1] = static_cast<uint8_t>(v);
+    }
+
+    size_t size() const { return m_data.size(); }
+    const std::vector<uint8_t>& data() const { return m_data; }
+
+private:
+    std::vector<uint8_t> m_data;
+};
+
+// Tipo de um valor para o verificador da JVM, como gravado na
+// StackMapTable; em objetos, index é a classe no constant pool
+struct verification_type {
+    enum tag_t : uint8_t {
+        top = 0,
+        integer = 1,
+        uninitialized_this = 6,
+        object = 7,
+        uninitialized = 8,
+    };
+
+    tag_t tag;
+    // classe (object) ou instrução new que criou o objeto (uninitialized)
+    uint32_t index;
+
+    bool operator==(const verification_type &other) const {
+        return tag == other.tag && index == other.index;
+    }
+    bool operator!=(const verification_type &other) const {
+        return !(*this == other);
+    }
+};
+
+// Monta um arquivo .class a partir dos campos e do código dos métodos, sem
+// passar pelo Jasmin. Os endereços dos desvios e os quadros da
+// StackMapTable, exigidos pelo verificador, são calculados aqui.
+class class_writer
+{
+public:
+    class_writer(const std::string &name, const std::string &super);
+
+    void add_field(uint16_t access, const std::string &name, const std::string &desc);
+    void add_method(uint16_t access, const std::string &name, const std::string &desc,
+                    int max_locals, const method_code &code);
+
+    void write(std::ostream &out) const;
+
+private:
+    struct frame {
+        std::vector<verification_type> locals;
+        std::vector<verification_type> stack;
+    };
+
+    // constant pool
+    uint16_t constant(const std::string &key, const byte_buffer &entry);
+    uint16_t utf8(const std::string &text);
+    uint16_t class_ref(const std::string &name);
+    uint16_t string_ref(const std::string &text);
+    uint16_t integer_ref(int32_t value);
+    uint16_t name_and_type(const std::string &name, const std::string &desc);
+    uint16_t member_ref(uint8_t tag, const insn &ins);
+
+    verification_type type_of(const std::string &desc, size_t pos);
+    frame initial_frame(uint16_t access, const std::string &name,
+                        const std::string &desc, int max_locals);
+    void execute(const insn &ins, size_t index, frame &f);
+    void merge(frame &into, const frame &from, bool &changed);
+    void infer_frames(const std::vector<insn> &code, const frame &entry,
+                      std::vector<frame> &states, std::vector<uint8_t> &reached,
+                      int &max_stack);
+
+    size_t encoded_size(const insn &ins);
+    void encode(const insn &ins, size_t offset, const std::vector<int32_t> &labels,
+                byte_buffer &out);
+    void write_frames(const std::vector<std::pair<uint32_t, const frame*>> &frames,
+                      const frame &entry, byte_buffer &out);
+    void write_type(const verification_type &type, byte_buffer &out);
+
+    uint16_t m_this;
+    uint16_t m_super;
+    byte_buffer m_pool;
+    uint16_t m_pool_count;
+    std::unordered_map<std::string, uint16_t> m_pool_index;
+    byte_buffer m_fields;
+    uint16_t m_field_count;
+    byte_buffer m_methods;
+    uint16_t m_method_count;
+};
+
+// Converte o texto de um literal da linguagem (com as aspas e as
+// sequências de escape) para o valor da string
+std::string unescape_literal(const std::string &literal);
+
+} // jvm
+} // ptb
@@ -2,19 +2,19 @@
 // Pararatibum - A linguagem do momento
 // -----------------------------------------------------------------------------
 
+#include <cstdint>
 #include <stdexcept>
-#include <memory>
+#include <unordered_map>
 #include <cppfmt/format.h>
 #include "codegen.h"
-#include "ast.h"
-#include "tokens.h"
 #include "types.h"
 
-// Gramática BNF da linguagem
+// Gera C++ a partir da IR: cada bloco básico vira um rótulo e os desvios
+// viram goto, exceto quando o destino é o bloco seguinte
 
 namespace ptb {
 
-code_gen::code_gen()
+code_gen::code_gen() : m_module(nullptr), m_function(nullptr)
 {
     m_out.open("ptb.cpp");
     if (!m_out.is_open()) {
@@ -22,178 +22,258 @@ code_gen::code_gen()
     }
 }
 
-void code_gen::translate(const ast::node_ptr &node)
+void code_gen::translate(const ir::module &m)
 {
-    switch (node->type) {
-    case ast::no_node: {
-        break;
+    m_module = &m;
+    m_out << fmt::sprintf("#include <iostream>\n");
+    m_out << fmt::sprintf("#include <string>\n");
+
+    for (const auto& g : m.globals) {
+        m_out << fmt::sprintf("%s%s;\n", c_type(g.type), name_of(g.name));
     }
-    case ast::integer_node: {
-        m_out << fmt::sprintf("%d", ast::to_integer(node)->value);
-        break;
+    m_out << fmt::sprintf("\n");
+
+    // protótipos, para que a ordem das definições não importe
+    bool has_init = !m.globals.empty();
+    if (has_init) {
+        m_out << fmt::sprintf("%s;\n", gen_signature(m.init));
     }
-    case ast::string_node: {
-        m_out << fmt::sprintf("%s", ast::to_lstring(node)->value);
-        break;
+    for (const auto& func : m.functions) {
+        if (!func.is_main) {
+            m_out << fmt::sprintf("%s;\n", gen_signature(func));
+        }
+    }
+    m_out << fmt::sprintf("\n");
+
+    if (has_init) {
+        gen_function(m.init);
     }
-    case ast::if_stmt_node: {
-        auto ifnode = ast::to_if_stmt(node);
-        m_out << fmt::sprintf("if (");
-        translate(ifnode->eval_expr);
-        m_out << fmt::sprintf(") {\n");
-        for (size_t i = 0; i < ifnode->true_statements.size(); i++) {
-            translate(ifnode->true_statements[i]);
+    for (const auto& func : m.functions) {
+        if (!func.blocks.empty()) {
+            gen_function(func);
         }
-        m_out << fmt::sprintf("}\n");
-        if (ifnode->false_statements.size()) {
-            m_out << fmt::sprintf("else {\n");
-            for (size_t i = 0; i < ifnode->false_statements.size(); i++) {
-                translate(ifnode->false_statements[i]);
+    }
+    m_module = nullptr;
+}
+
+void code_gen::gen_function(const ir::function &func)
+{
+    m_function = &func;
+    m_forest.build(func, true);
+
+    // variáveis com o mesmo nome na função recebem o número do registrador
+    m_names.assign(func.regs.size(), std::string());
+    std::unordered_map<name_id, int> seen;
+    for (size_t r = 0; r < func.regs.size(); r++) {
+        const auto& info = func.regs[r];
+        if (!info.named) {
+            m_names[r] = fmt::sprintf("_t%d", r);
+        } else if (seen[info.name]++ == 0) {
+            m_names[r] = name_of(info.name);
+        } else {
+            m_names[r] = fmt::sprintf("%s_%d", name_of(info.name), r);
+        }
+    }
+
+    m_out << fmt::sprintf("%s {\n", gen_signature(func));
+    if (func.is_main && !m_module->globals.empty()) {
+        m_out << fmt::sprintf("    ptb_init();\n");
+    }
+    // declara os registradores guardados que ainda aparecem no código
+    std::vector<uint8_t> declared(func.regs.size(), 0);
+    for (const auto& blk : func.blocks) {
+        for (const auto& ins : blk.code) {
+            if (ins.dst != ir::no_reg) {
+                declared[ins.dst] = 1;
             }
-            m_out << fmt::sprintf("}\n");
+            ir::for_each_operand(ins, [&](ir::vreg r) { declared[r] = 1; });
         }
-        break;
     }
-    case ast::while_stmt_node: {
-        auto whilenode = ast::to_while_stmt(node);
-        m_out << fmt::sprintf("while (");
-        translate(whilenode->eval_expr);
-        m_out << fmt::sprintf(") {\n");
-        for (size_t i = 0; i < whilenode->statements.size(); i++) {
-            translate(whilenode->statements[i]);
+    for (size_t r = func.param_count; r < func.regs.size(); r++) {
+        if (declared[r] && !m_forest.is_inlined_reg(static_cast<ir::vreg>(r))) {
+            m_out << fmt::sprintf("    %s%s;\n", c_type(func.regs[r].type), m_names[r]);
         }
-        m_out << fmt::sprintf("}\n");
-        break;
     }
-    case ast::return_stmt_node: {
-        auto retnode = ast::to_return_stmt(node);
-        m_out << fmt::sprintf("return ");
-        translate(retnode->expr);
-        m_out << fmt::sprintf(";\n");
-        break;
+
+    // apenas os blocos que recebem um goto precisam de rótulo
+    std::vector<uint8_t> labeled(func.blocks.size(), 0);
+    for (size_t b = 0; b < func.blocks.size(); b++) {
+        const auto& term = func.blocks[b].terminator();
+        int next = static_cast<int>(b + 1);
+        if (term.op == ir::op_jump && term.target != next) {
+            labeled[term.target] = 1;
+        } else if (term.op == ir::op_branch) {
+            if (term.target != next) {
+                labeled[term.target] = 1;
+            }
+            if (term.alt != next) {
+                labeled[term.alt] = 1;
+            }
+        }
     }
-    case ast::variable_node: {
-        m_out << fmt::sprintf("%s", ast::to_variable(node)->name);
-        break;
+
+    for (size_t b = 0; b < func.blocks.size(); b++) {
+        if (labeled[b]) {
+            m_out << fmt::sprintf("%s:\n", label(b));
+        }
+        const auto& code = func.blocks[b].code;
+        for (size_t i = 0; i < code.size(); i++) {
+            if (!m_forest.is_inlined(b, i)) {
+                gen_instr(code[i], b);
+            }
+        }
     }
-    case ast::assign_stmt_node: {
-        auto asignode = ast::to_assign_stmt(node);
-        translate(asignode->lvalue);
-        m_out << fmt::sprintf("=");
-        translate(asignode->rvalue);
-        m_out << fmt::sprintf(";\n");
+    m_out << fmt::sprintf("}\n\n");
+    m_function = nullptr;
+}
+
+void code_gen::gen_instr(const ir::instr &ins, int block)
+{
+    int next = block + 1;
+    switch (ins.op) {
+    case ir::op_read:
+        // para a IR a leitura sempre define dst; sem entrada o valor fica
+        // zerado em vez de manter o que a variável tinha antes
+        m_out << fmt::sprintf("    if (!(std::cin >> %s)) %s = %s;\n",
+                              m_names[ins.dst], m_names[ins.dst],
+                              m_function->regs[ins.dst].type == types::string ? "\"\"" : "0");
         break;
-    }
-    case ast::call_node: {
-        auto callnode = ast::to_call(node);
-        m_out << fmt::sprintf("%s(", callnode->name);
-        for (size_t i = 0; i < callnode->param_list.size(); i++) {
-            translate(callnode->param_list[i]);
-            if (i != callnode->param_list.size()-1)
-                m_out << fmt::sprintf(",");
+    case ir::op_write:
+        m_out << fmt::sprintf("    std::cout << (%s);\n", gen_expr(ins.a));
+        break;
+    case ir::op_store:
+        m_out << fmt::sprintf("    %s = %s;\n", name_of(m_module->globals[ins.imm].name),
+                              gen_expr(ins.a));
+        break;
+    case ir::op_jump:
+        if (ins.target != next) {
+            m_out << fmt::sprintf("    goto %s;\n", label(ins.target));
         }
-        if (callnode->is_stmt) {
-            m_out << fmt::sprintf(");\n");
+        break;
+    case ir::op_branch:
+        if (ins.target == next) {
+            m_out << fmt::sprintf("    if (!(%s)) goto %s;\n", gen_expr(ins.a), label(ins.alt));
         } else {
-            m_out << fmt::sprintf(")");
+            m_out << fmt::sprintf("    if (%s) goto %s;\n", gen_expr(ins.a), label(ins.target));
+            if (ins.alt != next) {
+                m_out << fmt::sprintf("    goto %s;\n", label(ins.alt));
+            }
         }
         break;
-    }
-    case ast::op_arithm_node: {
-        auto opnode = ast::to_op_arithm(node);
-        translate(opnode->left);
-        m_out << fmt::sprintf("%c", opnode->op);
-        translate(opnode->right);
-        break;
-    }
-    case ast::op_logical_node: {
-        auto opnode = ast::to_op_logical(node);
-        translate(opnode->left);
-        switch (opnode->op) {
-        case tok::eq: m_out << fmt::sprintf("=="); break;
-        case tok::ne: m_out << fmt::sprintf("!="); break;
-        case tok::ge: m_out << fmt::sprintf(">="); break;
-        case tok::le: m_out << fmt::sprintf("<="); break;
-        case tok::gt: m_out << fmt::sprintf(">"); break;
-        case tok::lt: m_out << fmt::sprintf("<"); break;
-        case tok::b_or: m_out << fmt::sprintf("||"); break;
-        case tok::b_and: m_out << fmt::sprintf("&&"); break;
+    case ir::op_ret:
+        if (m_function->is_main) {
+            m_out << fmt::sprintf("    return 0;\n");
+        } else if (ins.a != ir::no_reg) {
+            m_out << fmt::sprintf("    return %s;\n", gen_expr(ins.a));
+        } else if (block + 1 != static_cast<int>(m_function->blocks.size())) {
+            m_out << fmt::sprintf("    return;\n");
         }
-        translate(opnode->right);
         break;
-    }
-    case ast::program_node: {
-        m_out << fmt::sprintf("#include <iostream>\n");
-        m_out << fmt::sprintf("#include <string>\n");
-        auto program = ast::to_program(node);
-        for (size_t i = 0; i < program->declarations.size(); i++) {
-            translate(program->declarations[i]);
-            m_out << fmt::sprintf("\n");
+    default:
+        if (ins.dst == ir::no_reg) {
+            m_out << fmt::sprintf("    %s;\n", gen_value(ins));
+        } else {
+            m_out << fmt::sprintf("    %s = %s;\n", m_names[ins.dst], gen_value(ins));
         }
         break;
     }
-    case ast::type_node: {
-        auto typenode = ast::to_type(node);
-        switch (typenode->type_id) {
-        case types::integer: m_out << fmt::sprintf("int "); break;
-        case types::character: m_out << fmt::sprintf("char "); break;
-        case types::voidt: m_out << fmt::sprintf("void "); break;
-        case types::boolean: m_out << fmt::sprintf("bool "); break;
-        case types::string: m_out << fmt::sprintf("std::string "); break;
+}
+
+// Expressão que calcula o valor da instrução
+std::string code_gen::gen_value(const ir::instr &ins)
+{
+    const char *op = nullptr;
+    switch (ins.op) {
+    case ir::op_const:
+        // literais negativos precisam de parênteses para não formar "a--5"
+        if (ins.imm == INT32_MIN) {
+            return fmt::sprintf("(%d-1)", ins.imm + 1);
+        } else if (ins.imm < 0) {
+            return fmt::sprintf("(%d)", ins.imm);
         }
-        break;
+        return fmt::sprintf("%d", ins.imm);
+    case ir::op_string:
+        return name_of(ins.imm);
+    case ir::op_copy:
+        return gen_expr(ins.a);
+    case ir::op_load:
+        return name_of(m_module->globals[ins.imm].name);
+    case ir::op_call: {
+        std::string call = fmt::sprintf("%s(", name_of(m_module->functions[ins.imm].name));
+        for (size_t i = 0; i < ins.args.size(); i++) {
+            call += fmt::sprintf(i ? ", %s" : "%s", gen_expr(ins.args[i]));
+        }
+        return call + ")";
     }
-    case ast::argument_node: {
-        auto argnode = ast::to_argument(node);
-        translate(argnode->type_expr);
-        m_out << fmt::sprintf(argnode->name);
-        break;
+    case ir::op_add: op = "+"; break;
+    case ir::op_sub: op = "-"; break;
+    case ir::op_mul: op = "*"; break;
+    case ir::op_div: op = "/"; break;
+    case ir::op_rem: op = "%"; break;
+    case ir::op_eq: op = "=="; break;
+    case ir::op_ne: op = "!="; break;
+    case ir::op_lt: op = "<"; break;
+    case ir::op_le: op = "<="; break;
+    case ir::op_gt: op = ">"; break;
+    case ir::op_ge: op = ">="; break;
+    case ir::op_and: op = "&&"; break;
+    case ir::op_or: op = "||"; break;
+    default:
+        return fmt::sprintf("/* instrucao invalida para traducao %s */", ir::opcode_name(ins.op));
     }
-    case ast::variable_decl_node: {
-        auto vardnode = ast::to_variable_decl(node);
-        translate(vardnode->type_expr);
-        m_out << fmt::sprintf(vardnode->name);
-        if (vardnode->value->is_valid()) {
-            m_out << fmt::sprintf("=");
-            translate(vardnode->value);
-        }
-        m_out << fmt::sprintf(";\n");
-        break;
+    return fmt::sprintf("%s %s %s", gen_operand(ins.a), op, gen_operand(ins.b));
+}
+
+// Valor de um registrador: o nome ou, se ele foi absorvido, a
+// subexpressão que o calcula
+std::string code_gen::gen_expr(ir::vreg r)
+{
+    if (!m_forest.is_inlined_reg(r)) {
+        return m_names[r];
     }
-    case ast::function_decl_node: {
-        auto funcnode = ast::to_function_decl(node);
-        translate(funcnode->return_type);
+    return gen_value(m_forest.definition(*m_function, r));
+}
 
-        m_out << fmt::sprintf("%s(", funcnode->is_main() ? "main" : funcnode->name);
-        for (size_t i = 0; i < funcnode->arguments.size(); i++) {
-            translate(funcnode->arguments[i]);
-            if (i != funcnode->arguments.size()-1)
-                m_out << fmt::sprintf(",");
-        }
-        m_out << fmt::sprintf(") {\n");
-        for (size_t i = 0; i < funcnode->statements.size(); i++) {
-            translate(funcnode->statements[i]);
+// Operando de uma operação binária, entre parênteses se for outra operação
+std::string code_gen::gen_operand(ir::vreg r)
+{
+    if (m_forest.is_inlined_reg(r)) {
+        const auto& def = m_forest.definition(*m_function, r);
+        if (def.op >= ir::op_add && def.op <= ir::op_or) {
+            return fmt::sprintf("(%s)", gen_value(def));
         }
-        m_out << fmt::sprintf("}\n");
-        break;
     }
-    case ast::read_stmt_node: {
-        auto read = ast::to_read_stmt(node);
-        m_out << fmt::sprintf("std::cin >> %s;\n", read->identifier);
-        break;
+    return gen_expr(r);
+}
+
+std::string code_gen::gen_signature(const ir::function &func)
+{
+    if (func.is_main) {
+        return "int main()";
     }
-    case ast::write_stmt_node: {
-        auto write = ast::to_write_stmt(node);
-        m_out << fmt::sprintf("std::cout << (");
-        translate(write->expr);
-        m_out << fmt::sprintf(");\n");
-        break;
+    if (&func == &m_module->init) {
+        return "static void ptb_init()";
     }
-    default:
-        m_out << fmt::sprintf("/* ast::node invalido para traducao %d*/", node->type);
-        break;
+    std::string sig = fmt::sprintf("%s%s(", c_type(func.ret_type), name_of(func.name));
+    for (size_t i = 0; i < func.param_count; i++) {
+        sig += fmt::sprintf(i ? ", %s%s" : "%s%s", c_type(func.regs[i].type),
+                            name_of(func.regs[i].name));
     }
+    return sig + ")";
 }
 
+std::string code_gen::label(int block)
+{
+    return fmt::sprintf("L%d", block);
+}
+
+const char *code_gen::c_type(int type)
+{
+    switch (type) {
+    case types::integer: return "int ";
+    case types::string: return "std::string ";
+    }
+    return "void ";
+}
 
 }
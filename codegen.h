@@ -4,10 +4,10 @@
 
 #pragma once
 
-#include "ast.h"
-#include <vector>
-#include <functional>
 #include <fstream>
+#include <string>
+#include <vector>
+#include "ir.h"
 
 namespace ptb {
 
@@ -15,9 +15,23 @@ class code_gen
 {
 public:
     code_gen();
-    void translate(const ast::node_ptr &node);
+    void translate(const ir::module &m);
 private:
+    void gen_function(const ir::function &func);
+    void gen_instr(const ir::instr &ins, int block);
+    std::string gen_value(const ir::instr &ins);
+    std::string gen_expr(ir::vreg r);
+    std::string gen_operand(ir::vreg r);
+    std::string gen_signature(const ir::function &func);
+    static std::string label(int block);
+    static const char *c_type(int type);
+
     std::ofstream m_out;
+    const ir::module *m_module;
+    const ir::function *m_function;
+    ir::expr_forest m_forest;
+    // nome de cada registrador da função atual no código gerado
+    std::vector<std::string> m_names;
 };
 
 }
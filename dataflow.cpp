@@ -0,0 +1,229 @@
+// -----------------------------------------------------------------------------
+// Pararatibum - A linguagem do momento
+// -----------------------------------------------------------------------------
+
+#include <deque>
+#include "dataflow.h"
+#include "timing.h"
+
+namespace ptb { namespace ir {
+
+void bitvector::resize(size_t size, bool value)
+{
+    m_size = size;
+    m_words.assign((size + 63) / 64, value ? ~uint64_t(0) : 0);
+    trim();
+}
+
+void bitvector::set_all()
+{
+    for (auto& w : m_words) {
+        w = ~uint64_t(0);
+    }
+    trim();
+}
+
+void bitvector::clear()
+{
+    for (auto& w : m_words) {
+        w = 0;
+    }
+}
+
+// mantém zerados os bits além do tamanho, para que a comparação entre
+// conjuntos seja a comparação das palavras
+void bitvector::trim()
+{
+    if (m_size % 64) {
+        m_words.back() &= (uint64_t(1) << (m_size % 64)) - 1;
+    }
+}
+
+bool bitvector::union_with(const bitvector &other)
+{
+    uint64_t changed = 0;
+    for (size_t w = 0; w < m_words.size(); w++) {
+        uint64_t merged = m_words[w] | other.m_words[w];
+        changed |= merged ^ m_words[w];
+        m_words[w] = merged;
+    }
+    return changed != 0;
+}
+
+bool bitvector::intersect_with(const bitvector &other)
+{
+    uint64_t changed = 0;
+    for (size_t w = 0; w < m_words.size(); w++) {
+        uint64_t merged = m_words[w] & other.m_words[w];
+        changed |= merged ^ m_words[w];
+        m_words[w] = merged;
+    }
+    return changed != 0;
+}
+
+void bitvector::subtract(const bitvector &other)
+{
+    for (size_t w = 0; w < m_words.size(); w++) {
+        m_words[w] &= ~other.m_words[w];
+    }
+}
+
+dataflow_problem::dataflow_problem(direction dir_, meet_op meet_, size_t bits_,
+                                   size_t blocks) :
+    dir(dir_), meet(meet_), bits(bits_), gen(blocks, bitvector(bits_)),
+    kill(blocks, bitvector(bits_)), boundary(bits_)
+{
+}
+
+void solve(const cfg &graph, const dataflow_problem &problem,
+           dataflow_result &result)
+{
+    scoped_timer timer("dataflow");
+    size_t count = graph.size();
+    bool forward = problem.dir == dataflow_problem::forward;
+    bool intersection = problem.meet == dataflow_problem::meet_intersection;
+
+    // na interseção os conjuntos começam cheios e só diminuem
+    result.in.assign(count, bitvector(problem.bits, intersection));
+    result.out.assign(count, bitvector(problem.bits, intersection));
+    result.visits = 0;
+    auto& before = forward ? result.in : result.out;
+    auto& after = forward ? result.out : result.in;
+
+    // a ordem inicial faz a maioria dos blocos ver os vizinhos já
+    // calculados; os inalcançáveis entram no fim
+    std::deque<int32_t> work;
+    std::vector<uint8_t> queued(count, 1);
+    const auto& rpo = graph.reverse_postorder();
+    if (forward) {
+        work.assign(rpo.begin(), rpo.end());
+    } else {
+        work.assign(rpo.rbegin(), rpo.rend());
+    }
+    for (size_t b = 0; b < count; b++) {
+        if (!graph.reachable(static_cast<int32_t>(b))) {
+            work.push_back(static_cast<int32_t>(b));
+        }
+    }
+
+    bitvector value(problem.bits);
+    while (!work.empty()) {
+        int32_t b = work.front();
+        work.pop_front();
+        queued[b] = 0;
+        result.visits++;
+
+        const auto& sources = forward ? graph.preds(b) : graph.succs(b);
+        bool at_boundary = sources.empty() || (forward && b == 0);
+        if (at_boundary) {
+            value = problem.boundary;
+        } else {
+            value = after[sources[0]];
+        }
+        for (size_t k = at_boundary ? 0 : 1; k < sources.size(); k++) {
+            if (intersection) {
+                value.intersect_with(after[sources[k]]);
+            } else {
+                value.union_with(after[sources[k]]);
+            }
+        }
+        before[b] = value;
+
+        value.subtract(problem.kill[b]);
+        value.union_with(problem.gen[b]);
+        if (value != after[b]) {
+            after[b] = value;
+            const auto& targets = forward ? graph.succs(b) : graph.preds(b);
+            for (auto t : targets) {
+                if (!queued[t]) {
+                    queued[t] = 1;
+                    work.push_back(t);
+                }
+            }
+        }
+    }
+}
+
+void liveness::step(const instr &ins, bitvector &live)
+{
+    if (ins.dst != no_reg) {
+        live.reset(ins.dst);
+    }
+    for_each_operand(ins, [&](vreg r) { live.set(r); });
+}
+
+void liveness::compute(const function &func, const cfg &graph)
+{
+    scoped_timer timer("liveness");
+    dataflow_problem problem(dataflow_problem::backward,
+                             dataflow_problem::meet_union,
+                             func.regs.size(), func.blocks.size());
+    for (size_t b = 0; b < func.blocks.size(); b++) {
+        // gen: lidos antes de qualquer escrita no bloco, kill: escritos
+        auto& gen = problem.gen[b];
+        auto& kill = problem.kill[b];
+        const auto& code = func.blocks[b].code;
+        for (size_t i = code.size(); i-- > 0;) {
+            step(code[i], gen);
+            if (code[i].dst != no_reg) {
+                kill.set(code[i].dst);
+            }
+        }
+    }
+    solve(graph, problem, m_result);
+}
+
+void reaching_defs::compute(const function &func, const cfg &graph)
+{
+    scoped_timer timer("reaching_defs");
+    m_sites.clear();
+    m_defs.assign(func.regs.size(), std::vector<uint32_t>());
+    m_site_of.assign(func.blocks.size(), std::vector<uint32_t>());
+    // as definições da entrada são as primeiras, uma por registrador
+    for (size_t r = 0; r < func.regs.size(); r++) {
+        m_defs[r].push_back(static_cast<uint32_t>(m_sites.size()));
+        m_sites.push_back(site{-1, -1, static_cast<vreg>(r)});
+    }
+    for (size_t b = 0; b < func.blocks.size(); b++) {
+        const auto& code = func.blocks[b].code;
+        m_site_of[b].assign(code.size(), 0);
+        for (size_t i = 0; i < code.size(); i++) {
+            vreg r = code[i].dst;
+            if (r != no_reg) {
+                auto index = static_cast<uint32_t>(m_sites.size());
+                m_site_of[b][i] = index;
+                m_defs[r].push_back(index);
+                m_sites.push_back(site{static_cast<int32_t>(b),
+                                       static_cast<int32_t>(i), r});
+            }
+        }
+    }
+
+    dataflow_problem problem(dataflow_problem::forward,
+                             dataflow_problem::meet_union,
+                             m_sites.size(), func.blocks.size());
+    for (size_t r = 0; r < func.regs.size(); r++) {
+        problem.boundary.set(r);
+    }
+    for (size_t b = 0; b < func.blocks.size(); b++) {
+        // gen: última definição de cada registrador no bloco, kill: todas
+        // as definições dos registradores escritos
+        auto& gen = problem.gen[b];
+        auto& kill = problem.kill[b];
+        const auto& code = func.blocks[b].code;
+        for (size_t i = 0; i < code.size(); i++) {
+            vreg r = code[i].dst;
+            if (r != no_reg) {
+                for (auto d : m_defs[r]) {
+                    gen.reset(d);
+                    kill.set(d);
+                }
+                gen.set(m_site_of[b][i]);
+            }
+        }
+    }
+    solve(graph, problem, m_result);
+}
+
+} // ir
+} // ptb
@@ -0,0 +1,175 @@
+// -----------------------------------------------------------------------------
+// Pararatibum - A linguagem do momento
+// -----------------------------------------------------------------------------
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "cfg.h"
+#include "ir.h"
+
+namespace ptb { namespace ir {
+
+// Conjunto denso de bits, um por registrador ou por definição
+class bitvector
+{
+public:
+    bitvector() : m_size(0) {}
+    explicit bitvector(size_t size, bool value = false) {
+        resize(size, value);
+    }
+
+    void resize(size_t size, bool value = false);
+    size_t size() const { return m_size; }
+
+    bool test(size_t i) const { return (m_words[i / 64] >> (i % 64)) & 1; }
+    void set(size_t i) { m_words[i / 64] |= uint64_t(1) << (i % 64); }
+    void reset(size_t i) { m_words[i / 64] &= ~(uint64_t(1) << (i % 64)); }
+    void set_all();
+    void clear();
+
+    // as operações devolvem true se o conjunto mudou
+    bool union_with(const bitvector &other);
+    bool intersect_with(const bitvector &other);
+    void subtract(const bitvector &other);
+
+    bool operator==(const bitvector &other) const {
+        return m_words == other.m_words;
+    }
+    bool operator!=(const bitvector &other) const { return !(*this == other); }
+
+    template<typename F>
+    void for_each(F f) const {
+        for (size_t w = 0; w < m_words.size(); w++) {
+            uint64_t bits = m_words[w];
+            while (bits) {
+                f(w * 64 + __builtin_ctzll(bits));
+                bits &= bits - 1;
+            }
+        }
+    }
+
+private:
+    void trim();
+
+    std::vector<uint64_t> m_words;
+    size_t m_size;
+};
+
+// Problema de fluxo de dados em vetores de bits: cada bloco transforma o
+// conjunto que entra nele em out = gen | (in - kill), e os conjuntos que
+// chegam por arestas diferentes são combinados por união ou interseção.
+// Nos problemas para trás "entrada" e "saída" se referem ao sentido da
+// análise: o conjunto que entra num bloco é o do seu fim.
+struct dataflow_problem {
+    enum direction { forward, backward };
+    enum meet_op { meet_union, meet_intersection };
+
+    direction dir;
+    meet_op meet;
+    size_t bits;
+    // por bloco
+    std::vector<bitvector> gen;
+    std::vector<bitvector> kill;
+    // conjunto na entrada da função (para frente) ou nas saídas (para trás)
+    bitvector boundary;
+
+    dataflow_problem(direction dir_, meet_op meet_, size_t bits_, size_t blocks);
+};
+
+// Conjuntos no início (in) e no fim (out) de cada bloco, no sentido do
+// programa
+struct dataflow_result {
+    std::vector<bitvector> in;
+    std::vector<bitvector> out;
+    // blocos processados até o ponto fixo
+    unsigned visits;
+};
+
+// Resolve o problema com uma lista de trabalho: os blocos são visitados em
+// pós-ordem reversa (para frente) ou pós-ordem (para trás), e um bloco só
+// volta para a lista quando o conjunto de um vizinho muda
+void solve(const cfg &graph, const dataflow_problem &problem,
+           dataflow_result &result);
+
+// Registradores vivos: lidos em algum caminho antes de serem escritos de
+// novo
+class liveness
+{
+public:
+    void compute(const function &func, const cfg &graph);
+
+    const bitvector& live_in(int32_t b) const { return m_result.in[b]; }
+    const bitvector& live_out(int32_t b) const { return m_result.out[b]; }
+
+    // percorre o bloco de trás para frente; f(i, live) recebe cada
+    // instrução com os registradores vivos logo depois dela
+    template<typename F>
+    void backward(const function &func, int32_t b, F f) const {
+        bitvector live = m_result.out[b];
+        const auto& code = func.blocks[b].code;
+        for (size_t i = code.size(); i-- > 0;) {
+            f(i, static_cast<const bitvector&>(live));
+            step(code[i], live);
+        }
+    }
+    // atualiza o conjunto vivo depois de ins para antes de ins
+    static void step(const instr &ins, bitvector &live);
+
+private:
+    dataflow_result m_result;
+};
+
+// Definições que alcançam cada ponto: uma definição de r alcança um ponto
+// se existe um caminho dela até ele sem outra escrita em r. Cada
+// registrador tem também uma definição na entrada da função (block -1), o
+// valor que vem de fora: o argumento nos parâmetros, ou nenhum valor. Ela
+// alcança um ponto quando existe um caminho da entrada até ele sem
+// nenhuma escrita no registrador.
+class reaching_defs
+{
+public:
+    struct site {
+        int32_t block;
+        int32_t index;
+        vreg reg;
+
+        bool is_entry() const { return block < 0; }
+    };
+
+    void compute(const function &func, const cfg &graph);
+
+    const std::vector<site>& sites() const { return m_sites; }
+    // definições do registrador, como índices em sites()
+    const std::vector<uint32_t>& defs_of(vreg r) const { return m_defs[r]; }
+    const bitvector& reach_in(int32_t b) const { return m_result.in[b]; }
+    const bitvector& reach_out(int32_t b) const { return m_result.out[b]; }
+
+    // percorre o bloco para frente; f(i, reach) recebe cada instrução com
+    // as definições que chegam até ela
+    template<typename F>
+    void forward(const function &func, int32_t b, F f) const {
+        bitvector reach = m_result.in[b];
+        const auto& code = func.blocks[b].code;
+        for (size_t i = 0; i < code.size(); i++) {
+            f(i, static_cast<const bitvector&>(reach));
+            if (code[i].dst != no_reg) {
+                for (auto d : m_defs[code[i].dst]) {
+                    reach.reset(d);
+                }
+                reach.set(m_site_of[b][i]);
+            }
+        }
+    }
+
+private:
+    std::vector<site> m_sites;
+    std::vector<std::vector<uint32_t>> m_defs;
+    // índice em m_sites de cada instrução que define um registrador
+    std::vector<std::vector<uint32_t>> m_site_of;
+    dataflow_result m_result;
+};
+
+} // ir
+} // ptb
@@ -12,6 +12,7 @@
 #include "tokens.h"
 #include "types.h"
 #include "ast.h"
+#include "flatast.h"
 
 namespace ptb {
 
@@ -31,6 +32,11 @@ dotexport::dotexport()
 }
 
 void dotexport::run(const ast::node_ptr &ast)
+{
+    run(ast::flat_tree(ast));
+}
+
+void dotexport::run(const ast::flat_tree &tree)
 {
     m_node_counter = 0;
 
@@ -41,7 +47,7 @@ void dotexport::run(const ast::node_ptr &ast)
     m_out << fmt::sprintf("node [fontname = \"helvetica\"]\n");
     m_out << fmt::sprintf("edge [fontname = \"helvetica\"]\n");
 
-    export_node(ast);
+    export_node(tree, tree.root());
 
     for (auto pair : m_nodes) {
         m_out << fmt::sprintf("%d [label=\"%s\",shape=box]\n", pair.first, pair.second);
@@ -49,28 +55,27 @@ void dotexport::run(const ast::node_ptr &ast)
     m_out << fmt::sprintf("}\n");
 }
 
-int dotexport::export_node(const ast::node_ptr &node)
+int dotexport::export_node(const ast::flat_tree &tree, ast::flat_tree::index node)
 {
     using namespace ast;
-    if (!node->is_valid())
+    if (!tree.is_valid(node))
         return -1;
 
     int id = m_node_counter++;
 
-    switch (node->type) {
+    switch (tree.kind(node)) {
     case integer_node:
-        set_value(id, fmt::sprintf("%d", to_integer(node)->value));
+        set_value(id, fmt::sprintf("%d", tree.value(node)));
         return id;
 
     case string_node:
-        set_value(id, unquote(to_lstring(node)->value));
+        set_value(id, unquote(tree.text(node)));
         return id;
 
     case op_arithm_node: {
-        auto op = to_op_arithm(node);
-        int lhs = export_node(op->left);
-        int rhs = export_node(op->right);
-        set_value(id, fmt::sprintf("%c", op->op));
+        int lhs = export_node(tree, tree.child(node, 0));
+        int rhs = export_node(tree, tree.child(node, 1));
+        set_value(id, fmt::sprintf("%c", char(tree.value(node))));
         link_nodes(id, lhs);
         link_nodes(id, rhs);
         return id;
@@ -88,117 +93,108 @@ int dotexport::export_node(const ast::node_ptr &node)
             { b_and, "||"},
         };
 
-        auto op = to_op_logical(node);
-        int lhs = export_node(op->left);
-        int rhs = export_node(op->right);
-        set_value(id, fmt::sprintf("%s", log_names.at(op->op)));
+        int lhs = export_node(tree, tree.child(node, 0));
+        int rhs = export_node(tree, tree.child(node, 1));
+        set_value(id, fmt::sprintf("%s", log_names.at(tree.value(node))));
         link_nodes(id, lhs);
         link_nodes(id, rhs);
         return id;
     }
     case program_node: {
-        auto program = to_program(node);
         set_value(id, "program");
-        for (size_t i = 0; i < program->declarations.size(); i++) {
-            link_nodes(id, export_node(program->declarations[i]));
+        for (uint32_t i = 0; i < tree.child_count(node); i++) {
+            link_nodes(id, export_node(tree, tree.child(node, i)));
         }
         return id;
     }
 
     case if_stmt_node: {
-        auto stmt = to_if_stmt(node);
-        int eval = export_node(stmt->eval_expr);
+        int eval = export_node(tree, tree.child(node, 0));
         link_nodes(id, eval);
         int tmp = get_next_node();
         link_nodes(id, tmp);
         set_value(tmp, "true");
-        for (size_t i = 0; i < stmt->true_statements.size(); i++) {
-            link_nodes(tmp, export_node(stmt->true_statements[i]));
+        for (uint32_t i = 1; i < tree.split(node); i++) {
+            link_nodes(tmp, export_node(tree, tree.child(node, i)));
         }
 
         tmp = get_next_node();
         link_nodes(id, tmp);
         set_value(tmp, "false");
-        for (size_t i = 0; i < stmt->false_statements.size(); i++) {
-            link_nodes(tmp, export_node(stmt->false_statements[i]));
+        for (uint32_t i = tree.split(node); i < tree.child_count(node); i++) {
+            link_nodes(tmp, export_node(tree, tree.child(node, i)));
         }
 
         set_value(id, "if");
         return id;
     }
     case while_stmt_node: {
-        auto stmt = to_while_stmt(node);
-        int eval = export_node(stmt->eval_expr);
+        int eval = export_node(tree, tree.child(node, 0));
         link_nodes(id, eval);
         int tmp = get_next_node();
         link_nodes(id, tmp);
         set_value(tmp, "body");
-        for (size_t i = 0; i < stmt->statements.size(); i++) {
-            link_nodes(tmp, export_node(stmt->statements[i]));
+        for (uint32_t i = 1; i < tree.child_count(node); i++) {
+            link_nodes(tmp, export_node(tree, tree.child(node, i)));
         }
         set_value(id, "while");
         return id;
     }
     case return_stmt_node: {
-        auto stmt = to_return_stmt(node);
-        int expr = export_node(stmt->expr);
+        int expr = export_node(tree, tree.child(node, 0));
         link_nodes(id, expr);
         set_value(id, "return");
         return id;
     }
     case assign_stmt_node: {
-        auto op = to_assign_stmt(node);
-        int lhs = export_node(op->lvalue);
-        int rhs = export_node(op->rvalue);
+        int lhs = export_node(tree, tree.child(node, 0));
+        int rhs = export_node(tree, tree.child(node, 1));
         set_value(id, ":=");
         link_nodes(id, lhs);
         link_nodes(id, rhs);
         return id;
     }
     case variable_node:
-        set_value(id, to_variable(node)->name);
+        set_value(id, tree.text(node));
         return id;
 
     case variable_decl_node: {
-        auto var = to_variable_decl(node);
-        int lhs = export_node(var->type_expr);
-        int rhs = export_node(var->value);
-        set_value(id, fmt::sprintf("var: %s", var->name));
+        int lhs = export_node(tree, tree.child(node, 0));
+        int rhs = export_node(tree, tree.child(node, 1));
+        set_value(id, fmt::sprintf("var: %s", tree.text(node)));
         link_nodes(id, lhs);
         link_nodes(id, rhs);
         return id;
     }
     case function_decl_node: {
-        auto func = to_function_decl(node);
-        set_value(id, fmt::sprintf("func: %s", func->name));
-        link_nodes(id, export_node(func->return_type));
+        set_value(id, fmt::sprintf("func: %s", tree.text(node)));
+        link_nodes(id, export_node(tree, tree.child(node, 0)));
         int tmp = get_next_node();
         set_value(tmp, "args");
         link_nodes(id, tmp);
-        for (size_t i = 0; i < func->arguments.size(); i++) {
-            link_nodes(tmp, export_node(func->arguments[i]));
+        for (uint32_t i = 1; i < tree.split(node); i++) {
+            link_nodes(tmp, export_node(tree, tree.child(node, i)));
         }
-        if (!func->statements.empty()) {
+        if (tree.split(node) < tree.child_count(node)) {
             tmp = get_next_node();
             link_nodes(id, tmp);
             set_value(tmp, "body");
-            for (size_t i = 0; i < func->statements.size(); i++) {
-                link_nodes(tmp, export_node(func->statements[i]));
+            for (uint32_t i = tree.split(node); i < tree.child_count(node); i++) {
+                link_nodes(tmp, export_node(tree, tree.child(node, i)));
             }
         }
         return id;
     }
     case call_node: {
-        auto call = to_call(node);
-        set_value(id, fmt::sprintf("call: %s", call->name));
-        for (size_t i = 0; i < call->param_list.size(); i++) {
-            link_nodes(id, export_node(call->param_list[i]));
+        set_value(id, fmt::sprintf("call: %s", tree.text(node)));
+        for (uint32_t i = 0; i < tree.child_count(node); i++) {
+            link_nodes(id, export_node(tree, tree.child(node, i)));
         }
         return id;
     }
 
     case type_node:
-        switch (to_type(node)->type_id) {
+        switch (tree.value(node)) {
         case types::integer: set_value(id, "int"); break;
         case types::boolean: set_value(id, "bool"); break;
         case types::string: set_value(id, "string"); break;
@@ -207,24 +203,21 @@ int dotexport::export_node(const ast::node_ptr &node)
         }
         return id;
     case argument_node: {
-        auto arg = to_argument(node);
         int tmp = get_next_node();
         set_value(id, "arg");
-        set_value(tmp, arg->name);
-        int type = export_node(arg->type_expr);
+        set_value(tmp, tree.text(node));
+        int type = export_node(tree, tree.child(node, 0));
         link_nodes(tmp, type);
         link_nodes(id, tmp);
         return id;
     }
     case read_stmt_node: {
-        auto read = to_read_stmt(node);
-        set_value(id, fmt::sprintf("read: %s", read->identifier));
+        set_value(id, fmt::sprintf("read: %s", tree.text(node)));
         return id;
     }
     case write_stmt_node: {
-        auto write = to_write_stmt(node);
         set_value(id, "write");
-        int expr = export_node(write->expr);
+        int expr = export_node(tree, tree.child(node, 0));
         link_nodes(id, expr);
         return id;
     }
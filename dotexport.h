@@ -8,6 +8,7 @@
 #include <string>
 #include <fstream>
 #include "ast.h"
+#include "flatast.h"
 
 namespace ptb {
 
@@ -16,8 +17,9 @@ class dotexport
 public:
     dotexport();
     void run(const ast::node_ptr &ast);
+    void run(const ast::flat_tree &tree);
 private:
-    int export_node(const ast::node_ptr &node);
+    int export_node(const ast::flat_tree &tree, ast::flat_tree::index node);
     void set_value(int id, const std::string &str);
     void link_nodes(int from, int to);
     int m_node_counter;
@@ -0,0 +1,72 @@
+#!/bin/sh
+# -----------------------------------------------------------------------------
+# Pararatibum - A linguagem do momento
+# -----------------------------------------------------------------------------
+#
+# Compila cada programa com -O0 e com -O1, compara o número de linhas do
+# ptb.j gerado e confere se o programa imprime a mesma coisa nos dois
+# níveis. O ptb.cpp é compilado com $CXX (c++ por padrão) e executado com a
+# entrada de <programa>.entrada, se existir. Só os primeiros 64 KiB da saída
+# são comparados, já que primos.ptb repete a pergunta depois do fim da
+# entrada.
+#
+# Falha se algum programa não compilar, se a saída mudar com -O1 ou se o
+# ptb.j de constantes.ptb não diminuir com -O1.
+#
+# Uso: examples/compara_O1.sh [ptbc] [programas...]
+#      (por padrão ./ptbc e todos os .ptb de examples/)
+
+PTBC=${1:-./ptbc}
+[ $# -gt 0 ] && shift
+CXX=${CXX:-c++}
+DIR=$(cd "$(dirname "$0")" && pwd)
+if [ $# -eq 0 ]; then
+    set -- "$DIR"/*.ptb
+fi
+case $PTBC in
+    /*) ;;
+    *) PTBC=$(pwd)/$PTBC ;;
+esac
+
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+
+# compila $1 com a opção $2, grava a saída do programa em $WORK/saida$2 e
+# escreve as linhas do ptb.j
+compila() {
+    rm -f "$WORK/ptb.j" "$WORK/ptb.cpp"
+    (cd "$WORK" && "$PTBC" "$2" "$1" > ptbc.txt 2>&1)
+    if ! grep -q "compilado com sucesso" "$WORK/ptbc.txt"; then
+        cat "$WORK/ptbc.txt" >&2
+        return 1
+    fi
+    # a linguagem usa aritmética de 32 bits com estouro, como a JVM
+    if ! $CXX -fwrapv -w -o "$WORK/prog" "$WORK/ptb.cpp"; then
+        return 1
+    fi
+    entrada=${1%.ptb}.entrada
+    [ -f "$entrada" ] || entrada=/dev/null
+    timeout 10 "$WORK/prog" < "$entrada" 2>&1 | head -c 65536 > "$WORK/saida$2"
+    wc -l < "$WORK/ptb.j" | tr -d ' '
+}
+
+status=0
+printf '%-20s %8s %8s  %s\n' programa -O0 -O1 saida
+for prog in "$@"; do
+    prog=$(cd "$(dirname "$prog")" && pwd)/$(basename "$prog")
+    o0=$(compila "$prog" -O0) || { echo "$prog nao compilou com -O0" >&2; status=1; continue; }
+    o1=$(compila "$prog" -O1) || { echo "$prog nao compilou com -O1" >&2; status=1; continue; }
+    name=$(basename "$prog")
+    if cmp -s "$WORK/saida-O0" "$WORK/saida-O1"; then
+        saida=igual
+    else
+        saida=DIFERENTE
+        status=1
+    fi
+    printf '%-20s %8d %8d  %s\n' "$name" "$o0" "$o1" "$saida"
+    if [ "$name" = constantes.ptb ] && [ "$o1" -ge "$o0" ]; then
+        echo "constantes.ptb: -O1 nao diminuiu o ptb.j" >&2
+        status=1
+    fi
+done
+exit $status
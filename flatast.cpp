@@ -0,0 +1,370 @@
+// -----------------------------------------------------------------------------
+// Pararatibum - A linguagem do momento
+// -----------------------------------------------------------------------------
+
+#include <cstring>
+#include "flatast.h"
+
+namespace ptb { namespace ast {
+
+const flat_tree::index flat_tree::none;
+
+flat_tree::flat_tree()
+{
+    clear();
+}
+
+flat_tree::flat_tree(const node_ptr &root)
+{
+    build(root);
+}
+
+void flat_tree::clear()
+{
+    m_kinds.clear();
+    m_flags.clear();
+    m_values.clear();
+    m_splits.clear();
+    m_first_child.clear();
+    m_child_counts.clear();
+    m_edges.clear();
+    m_chars.clear();
+    m_str_offsets.assign(1, 0);
+    m_str_ids.clear();
+
+    // índice 0: nó vazio
+    m_root = add_node(no_node);
+}
+
+void flat_tree::build(const node_ptr &root)
+{
+    clear();
+    m_root = add(root);
+    m_str_ids.clear();
+}
+
+flat_tree::index flat_tree::add_node(ast_type kind, int32_t value, uint8_t flags)
+{
+    index n = static_cast<index>(m_kinds.size());
+    m_kinds.push_back(static_cast<uint8_t>(kind));
+    m_flags.push_back(flags);
+    m_values.push_back(value);
+    m_splits.push_back(0);
+    m_first_child.push_back(0);
+    m_child_counts.push_back(0);
+    return n;
+}
+
+uint32_t flat_tree::reserve_children(index n, uint32_t count)
+{
+    uint32_t first = static_cast<uint32_t>(m_edges.size());
+    m_first_child[n] = first;
+    m_child_counts[n] = count;
+    m_edges.resize(first + count, none);
+    return first;
+}
+
+void flat_tree::set_child(uint32_t &edge, const node_ptr &child)
+{
+    // add() pode realocar m_edges, então o filho é criado antes
+    index c = add(child);
+    m_edges[edge++] = c;
+}
+
+void flat_tree::set_children(uint32_t &edge, const node_list &children)
+{
+    for (size_t i = 0; i < children.size(); i++) {
+        set_child(edge, children[i]);
+    }
+}
+
+int32_t flat_tree::add_string(name_id name)
+{
+    if (name >= m_str_ids.size()) {
+        m_str_ids.resize(names().size(), -1);
+    }
+    if (m_str_ids[name] >= 0) {
+        return m_str_ids[name];
+    }
+    const std::string &str = name_of(name);
+    int32_t id = static_cast<int32_t>(m_str_offsets.size() - 1);
+    m_chars.insert(m_chars.end(), str.begin(), str.end());
+    m_str_offsets.push_back(static_cast<uint32_t>(m_chars.size()));
+    m_str_ids[name] = id;
+    return id;
+}
+
+flat_tree::index flat_tree::add(const node_ptr &node)
+{
+    if (!node || !node->is_valid()) {
+        return none;
+    }
+
+    switch (node->type) {
+    case program_node: {
+        auto program = to_program(node);
+        index n = add_node(program_node);
+        uint32_t e = reserve_children(n, program->declarations.size());
+        set_children(e, program->declarations);
+        return n;
+    }
+    case if_stmt_node: {
+        auto stmt = to_if_stmt(node);
+        index n = add_node(if_stmt_node);
+        m_splits[n] = 1 + stmt->true_statements.size();
+        uint32_t e = reserve_children(n, 1 + stmt->true_statements.size() +
+                                      stmt->false_statements.size());
+        set_child(e, stmt->eval_expr);
+        set_children(e, stmt->true_statements);
+        set_children(e, stmt->false_statements);
+        return n;
+    }
+    case while_stmt_node: {
+        auto stmt = to_while_stmt(node);
+        index n = add_node(while_stmt_node);
+        uint32_t e = reserve_children(n, 1 + stmt->statements.size());
+        set_child(e, stmt->eval_expr);
+        set_children(e, stmt->statements);
+        return n;
+    }
+    case return_stmt_node: {
+        index n = add_node(return_stmt_node);
+        uint32_t e = reserve_children(n, 1);
+        set_child(e, to_return_stmt(node)->expr);
+        return n;
+    }
+    case assign_stmt_node: {
+        auto assign = to_assign_stmt(node);
+        index n = add_node(assign_stmt_node);
+        uint32_t e = reserve_children(n, 2);
+        set_child(e, assign->lvalue);
+        set_child(e, assign->rvalue);
+        return n;
+    }
+    case type_node:
+        return add_node(type_node, to_type(node)->type_id);
+
+    case argument_node: {
+        auto arg = to_argument(node);
+        index n = add_node(argument_node, add_string(arg->name));
+        uint32_t e = reserve_children(n, 1);
+        set_child(e, arg->type_expr);
+        return n;
+    }
+    case variable_node:
+        return add_node(variable_node, add_string(to_variable(node)->name));
+
+    case variable_decl_node: {
+        auto var = to_variable_decl(node);
+        index n = add_node(variable_decl_node, add_string(var->name));
+        uint32_t e = reserve_children(n, 2);
+        set_child(e, var->type_expr);
+        set_child(e, var->value);
+        return n;
+    }
+    case function_decl_node: {
+        auto func = to_function_decl(node);
+        index n = add_node(function_decl_node, add_string(func->name),
+                           func->is_prototype ? flag_prototype : 0);
+        m_splits[n] = 1 + func->arguments.size();
+        uint32_t e = reserve_children(n, 1 + func->arguments.size() +
+                                      func->statements.size());
+        set_child(e, func->return_type);
+        set_children(e, func->arguments);
+        set_children(e, func->statements);
+        return n;
+    }
+    case call_node: {
+        auto call = to_call(node);
+        index n = add_node(call_node, add_string(call->name),
+                           call->is_stmt ? flag_stmt : 0);
+        uint32_t e = reserve_children(n, call->param_list.size());
+        set_children(e, call->param_list);
+        return n;
+    }
+    case integer_node:
+        return add_node(integer_node, to_integer(node)->value);
+
+    case string_node:
+        return add_node(string_node, add_string(to_lstring(node)->value));
+
+    case op_arithm_node: {
+        auto op = to_op_arithm(node);
+        index n = add_node(op_arithm_node, op->op);
+        uint32_t e = reserve_children(n, 2);
+        set_child(e, op->left);
+        set_child(e, op->right);
+        return n;
+    }
+    case op_logical_node: {
+        auto op = to_op_logical(node);
+        index n = add_node(op_logical_node, op->op);
+        uint32_t e = reserve_children(n, 2);
+        set_child(e, op->left);
+        set_child(e, op->right);
+        return n;
+    }
+    case read_stmt_node:
+        return add_node(read_stmt_node, add_string(to_read_stmt(node)->identifier));
+
+    case write_stmt_node: {
+        index n = add_node(write_stmt_node);
+        uint32_t e = reserve_children(n, 1);
+        set_child(e, to_write_stmt(node)->expr);
+        return n;
+    }
+    case no_node:
+        break;
+    }
+    return none;
+}
+
+// Formato binário: cabeçalho com a assinatura, a versão e o tamanho de cada
+// vetor, seguido do conteúdo dos vetores na ordem da máquina.
+
+static const char flat_magic[4] = { 'P', 'T', 'B', 'A' };
+static const uint32_t flat_version = 1;
+
+template<typename T>
+static void write_array(std::ostream &out, const std::vector<T> &v)
+{
+    if (!v.empty()) {
+        out.write(reinterpret_cast<const char*>(v.data()), v.size() * sizeof(T));
+    }
+}
+
+template<typename T>
+static void read_array(std::istream &in, std::vector<T> &v, uint32_t count)
+{
+    v.resize(count);
+    if (count > 0) {
+        in.read(reinterpret_cast<char*>(v.data()), count * sizeof(T));
+    }
+}
+
+void flat_tree::write(std::ostream &out) const
+{
+    uint32_t header[] = {
+        flat_version,
+        m_root,
+        static_cast<uint32_t>(m_kinds.size()),
+        static_cast<uint32_t>(m_edges.size()),
+        static_cast<uint32_t>(m_chars.size()),
+        static_cast<uint32_t>(m_str_offsets.size()),
+    };
+    out.write(flat_magic, sizeof(flat_magic));
+    out.write(reinterpret_cast<const char*>(header), sizeof(header));
+    write_array(out, m_kinds);
+    write_array(out, m_flags);
+    write_array(out, m_values);
+    write_array(out, m_splits);
+    write_array(out, m_first_child);
+    write_array(out, m_child_counts);
+    write_array(out, m_edges);
+    write_array(out, m_chars);
+    write_array(out, m_str_offsets);
+    if (!out) {
+        throw flat_error("Erro ao gravar a AST");
+    }
+}
+
+void flat_tree::read(std::istream &in)
+{
+    char magic[sizeof(flat_magic)];
+    uint32_t header[6];
+    in.read(magic, sizeof(magic));
+    in.read(reinterpret_cast<char*>(header), sizeof(header));
+    if (!in || memcmp(magic, flat_magic, sizeof(magic)) != 0) {
+        throw flat_error("Arquivo nao contem uma AST valida");
+    }
+    if (header[0] != flat_version) {
+        throw flat_error("Versao da AST nao suportada");
+    }
+    uint32_t nodes = header[2], edges = header[3], chars = header[4], strings = header[5];
+
+    clear();
+    m_root = header[1];
+    read_array(in, m_kinds, nodes);
+    read_array(in, m_flags, nodes);
+    read_array(in, m_values, nodes);
+    read_array(in, m_splits, nodes);
+    read_array(in, m_first_child, nodes);
+    read_array(in, m_child_counts, nodes);
+    read_array(in, m_edges, edges);
+    read_array(in, m_chars, chars);
+    read_array(in, m_str_offsets, strings);
+    if (!in) {
+        clear();
+        throw flat_error("AST truncada");
+    }
+
+    // verifica os índices antes de confiar no conteúdo
+    bool ok = nodes > 0 && m_kinds[none] == no_node && m_root < nodes && strings > 0;
+    for (uint32_t i = 0; ok && i < edges; i++) {
+        ok = m_edges[i] < nodes;
+    }
+    for (uint32_t n = 0; ok && n < nodes; n++) {
+        ok = m_kinds[n] <= write_stmt_node &&
+             uint64_t(m_first_child[n]) + m_child_counts[n] <= edges;
+    }
+    for (uint32_t s = 1; ok && s < strings; s++) {
+        ok = m_str_offsets[s - 1] <= m_str_offsets[s] && m_str_offsets[s] <= chars;
+    }
+    for (uint32_t n = 0; ok && n < nodes; n++) {
+        switch (m_kinds[n]) {
+        case argument_node: case variable_node: case variable_decl_node:
+        case function_decl_node: case call_node: case string_node:
+        case read_stmt_node:
+            ok = m_values[n] >= 0 && uint32_t(m_values[n]) + 1 < strings;
+            break;
+        }
+    }
+    // número de filhos de cada tipo de nó, como build() grava
+    for (uint32_t n = 0; ok && n < nodes; n++) {
+        uint32_t count = m_child_counts[n], split = m_splits[n];
+        ok = split <= count;
+        switch (m_kinds[n]) {
+        case if_stmt_node: case function_decl_node:
+            ok = ok && split >= 1;
+            break;
+        case while_stmt_node:
+            ok = ok && count >= 1;
+            break;
+        case return_stmt_node: case argument_node: case write_stmt_node:
+            ok = ok && count == 1;
+            break;
+        case assign_stmt_node: case variable_decl_node:
+        case op_arithm_node: case op_logical_node:
+            ok = ok && count == 2;
+            break;
+        case program_node: case call_node:
+            break;
+        default:
+            ok = ok && count == 0;
+            break;
+        }
+    }
+    // as arestas formam uma árvore: build() numera cada nó antes dos seus
+    // filhos, então toda aresta aponta para um índice maior (sem ciclos) e
+    // nenhum nó além do vazio tem mais de um pai ou é filho da raiz
+    std::vector<bool> has_parent(ok ? nodes : 0, false);
+    for (uint32_t n = 0; ok && n < nodes; n++) {
+        for (uint32_t i = 0; ok && i < m_child_counts[n]; i++) {
+            index c = m_edges[m_first_child[n] + i];
+            if (c == none) {
+                continue;
+            }
+            ok = c > n && c != m_root && !has_parent[c];
+            if (ok) {
+                has_parent[c] = true;
+            }
+        }
+    }
+    if (!ok) {
+        clear();
+        throw flat_error("AST corrompida");
+    }
+}
+
+} // ast
+} // ptb
@@ -0,0 +1,120 @@
+// -----------------------------------------------------------------------------
+// Pararatibum - A linguagem do momento
+// -----------------------------------------------------------------------------
+
+#pragma once
+
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "ast.h"
+
+namespace ptb { namespace ast {
+
+struct flat_error : public std::runtime_error {
+    flat_error(const std::string& w) : std::runtime_error(w) {
+    }
+};
+
+// Representação compacta da AST: os nós ficam em vetores paralelos
+// (struct-of-arrays) endereçados por índices de 32 bits e os filhos de
+// cada nó são um intervalo contíguo de um vetor de arestas compartilhado.
+// O índice 0 é sempre o nó vazio (no_node).
+//
+// Filhos e campos de cada tipo de nó:
+//
+//   program        declarações...
+//   if_stmt        condição, verdadeiros..., falsos...   split = 1 + nº verdadeiros
+//   while_stmt     condição, statements...
+//   return_stmt    expressão
+//   assign_stmt    lvalue, rvalue
+//   type           value = id do tipo
+//   argument       tipo                                  value = nome
+//   variable                                             value = nome
+//   variable_decl  tipo, valor                           value = nome
+//   function_decl  retorno, argumentos..., statements... value = nome,
+//                                                        split = 1 + nº argumentos,
+//                                                        flag_prototype
+//   call           parâmetros...                         value = nome, flag_stmt
+//   integer                                              value = valor
+//   lstring                                              value = string
+//   op_arithm      esquerda, direita                     value = operador
+//   op_logical     esquerda, direita                     value = operador
+//   read_stmt                                            value = identificador
+//   write_stmt     expressão
+//
+// Os nomes são guardados uma única vez num pool de caractéres próprio,
+// então a árvore inteira é serializada copiando os vetores.
+class flat_tree
+{
+public:
+    typedef uint32_t index;
+    static const index none = 0;
+
+    enum {
+        flag_prototype = 1,
+        flag_stmt = 2,
+    };
+
+    flat_tree();
+    explicit flat_tree(const node_ptr &root);
+
+    // Converte uma árvore de ponteiros
+    void build(const node_ptr &root);
+    void clear();
+
+    index root() const { return m_root; }
+    size_t size() const { return m_kinds.size(); }
+
+    ast_type kind(index n) const { return static_cast<ast_type>(m_kinds[n]); }
+    bool is_valid(index n) const { return m_kinds[n] != no_node; }
+    bool has_flag(index n, unsigned flag) const { return (m_flags[n] & flag) != 0; }
+    int32_t value(index n) const { return m_values[n]; }
+    uint32_t split(index n) const { return m_splits[n]; }
+
+    // Texto do nó (nome, identificador ou literal)
+    std::string text(index n) const {
+        uint32_t s = m_values[n];
+        return std::string(m_chars.data() + m_str_offsets[s],
+                           m_str_offsets[s + 1] - m_str_offsets[s]);
+    }
+
+    uint32_t child_count(index n) const { return m_child_counts[n]; }
+    index child(index n, uint32_t i) const { return m_edges[m_first_child[n] + i]; }
+
+    // Grava e lê a árvore num formato binário. read() confere os índices,
+    // o número de filhos de cada tipo de nó e o formato de árvore antes de
+    // aceitar o conteúdo, e lança flat_error se algo não bater.
+    void write(std::ostream &out) const;
+    void read(std::istream &in);
+
+private:
+    index add(const node_ptr &node);
+    index add_node(ast_type kind, int32_t value = 0, uint8_t flags = 0);
+    // reserva count arestas para os filhos de n e devolve a primeira
+    uint32_t reserve_children(index n, uint32_t count);
+    void set_child(uint32_t &edge, const node_ptr &child);
+    void set_children(uint32_t &edge, const node_list &children);
+    int32_t add_string(name_id name);
+
+    index m_root;
+
+    std::vector<uint8_t> m_kinds;
+    std::vector<uint8_t> m_flags;
+    std::vector<int32_t> m_values;
+    std::vector<uint32_t> m_splits;
+    std::vector<uint32_t> m_first_child;
+    std::vector<uint32_t> m_child_counts;
+    std::vector<index> m_edges;
+
+    std::vector<char> m_chars;
+    std::vector<uint32_t> m_str_offsets;
+    // id no pool de cada nome já visto durante a conversão, -1 se nenhum
+    std::vector<int32_t> m_str_ids;
+};
+
+} // ast
+} // ptb
@@ -0,0 +1,70 @@
+// -----------------------------------------------------------------------------
+// Pararatibum - A linguagem do momento
+// -----------------------------------------------------------------------------
+
+#include <cstring>
+#include "interner.h"
+
+namespace ptb {
+
+interner::interner() : m_slots(64, -1)
+{
+}
+
+// FNV-1a
+uint32_t interner::hash(const char *str, size_t len)
+{
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        h ^= static_cast<unsigned char>(str[i]);
+        h *= 16777619u;
+    }
+    return h;
+}
+
+name_id interner::intern(const char *str, size_t len)
+{
+    uint32_t h = hash(str, len);
+    size_t mask = m_slots.size() - 1;
+    size_t i = h & mask;
+    while (m_slots[i] >= 0) {
+        int id = m_slots[i];
+        const std::string &s = m_strings[id];
+        if (m_hashes[id] == h && s.size() == len &&
+                std::memcmp(s.data(), str, len) == 0) {
+            return id;
+        }
+        i = (i + 1) & mask;
+    }
+
+    int id = static_cast<int>(m_strings.size());
+    m_strings.emplace_back(str, len);
+    m_hashes.push_back(h);
+    m_slots[i] = id;
+
+    // mantém a tabela no máximo meio cheia
+    if (m_strings.size() * 2 > m_slots.size())
+        grow();
+    return id;
+}
+
+void interner::grow()
+{
+    std::vector<int> slots(m_slots.size() * 2, -1);
+    size_t mask = slots.size() - 1;
+    for (size_t id = 0; id < m_strings.size(); id++) {
+        size_t i = m_hashes[id] & mask;
+        while (slots[i] >= 0)
+            i = (i + 1) & mask;
+        slots[i] = static_cast<int>(id);
+    }
+    m_slots.swap(slots);
+}
+
+interner& names()
+{
+    static interner table;
+    return table;
+}
+
+}
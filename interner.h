@@ -0,0 +1,52 @@
+// -----------------------------------------------------------------------------
+// Pararatibum - A linguagem do momento
+// -----------------------------------------------------------------------------
+
+#pragma once
+
+#include <string>
+#include <deque>
+#include <vector>
+#include <cstdint>
+
+namespace ptb {
+
+// Identificador de uma string internada
+typedef uint32_t name_id;
+
+// Tabela de strings internadas: cada texto distinto é armazenado uma única
+// vez e representado por um inteiro pequeno (name_id), então comparar dois
+// nomes é comparar dois inteiros. A busca é feita direto sobre
+// (ponteiro, tamanho), então um texto que já está na tabela não causa
+// nenhuma alocação.
+class interner
+{
+public:
+    interner();
+
+    name_id intern(const char *str, size_t len);
+    name_id intern(const std::string &str) {
+        return intern(str.data(), str.size());
+    }
+    const std::string& str(name_id id) const { return m_strings[id]; }
+    size_t size() const { return m_strings.size(); }
+
+private:
+    static uint32_t hash(const char *str, size_t len);
+    void grow();
+
+    std::deque<std::string> m_strings;
+    // endereçamento aberto: índice em m_strings ou -1 para slot vazio
+    std::vector<int> m_slots;
+    std::vector<uint32_t> m_hashes;
+};
+
+// Tabela compartilhada por todas as fases do compilador: identificadores e
+// literais da AST, tabela de símbolos e geradores de código usam os mesmos ids.
+interner& names();
+
+inline const std::string& name_of(name_id id) {
+    return names().str(id);
+}
+
+}
@@ -0,0 +1,214 @@
+// -----------------------------------------------------------------------------
+// Pararatibum - A linguagem do momento
+// -----------------------------------------------------------------------------
+
+#include <cppfmt/format.h>
+#include "ir.h"
+
+namespace ptb { namespace ir {
+
+void expr_forest::build(const function &func, bool calls_in_order)
+{
+    size_t total = 0;
+    m_offsets.resize(func.blocks.size());
+    for (size_t b = 0; b < func.blocks.size(); b++) {
+        m_offsets[b] = total;
+        total += func.blocks[b].code.size();
+    }
+    m_inlined.assign(total, 0);
+    m_def_block.assign(func.regs.size(), -1);
+    m_def_index.assign(func.regs.size(), -1);
+
+    std::vector<uint32_t> uses(func.regs.size(), 0);
+    for (const auto& blk : func.blocks) {
+        for (const auto& ins : blk.code) {
+            for_each_operand(ins, [&](vreg r) { uses[r]++; });
+        }
+    }
+
+    // definições ainda não lidas, na ordem em que aparecem no bloco
+    std::vector<size_t> pending;
+    std::vector<uint8_t> is_pending(func.regs.size(), 0);
+    std::vector<vreg> operands;
+
+    auto flush = [&](const block &blk) {
+        for (auto i : pending) {
+            is_pending[blk.code[i].dst] = 0;
+        }
+        pending.clear();
+    };
+
+    for (size_t b = 0; b < func.blocks.size(); b++) {
+        const auto& blk = func.blocks[b];
+        for (size_t i = 0; i < blk.code.size(); i++) {
+            const auto& ins = blk.code[i];
+
+            operands.clear();
+            for_each_operand(ins, [&](vreg r) {
+                if (is_pending[r] && uses[r] == 1) {
+                    operands.push_back(r);
+                }
+            });
+            // as definições lidas precisam ser exatamente as últimas
+            // pendentes, na ordem dos operandos, para que nada seja
+            // avaliado fora de ordem
+            bool matches = operands.size() <= pending.size();
+            size_t base = pending.size() - (matches ? operands.size() : 0);
+            for (size_t k = 0; matches && k < operands.size(); k++) {
+                matches = blk.code[pending[base + k]].dst == operands[k];
+            }
+            if (matches) {
+                for (size_t k = 0; k < operands.size(); k++) {
+                    size_t def = pending[base + k];
+                    m_inlined[m_offsets[b] + def] = 1;
+                    m_def_block[operands[k]] = static_cast<int32_t>(b);
+                    m_def_index[operands[k]] = static_cast<int32_t>(def);
+                    is_pending[operands[k]] = 0;
+                }
+                pending.resize(base);
+            }
+            if (calls_in_order && ins.op == op_call) {
+                flush(blk);
+            }
+
+            bool inlinable = ins.dst != no_reg && !func.regs[ins.dst].named &&
+                             uses[ins.dst] == 1 && ins.op != op_read;
+            if (inlinable && calls_in_order && !pending.empty() &&
+                blk.code[pending.back()].op == op_call &&
+                ins.op != op_const && ins.op != op_string) {
+                // o que vem depois da chamada não pode ser avaliado antes
+                // dela: a chamada fica num temporário
+                flush(blk);
+            }
+            if (inlinable) {
+                pending.push_back(i);
+                is_pending[ins.dst] = 1;
+            } else {
+                // statements com efeito encerram as expressões em aberto
+                flush(blk);
+            }
+        }
+        flush(blk);
+    }
+}
+
+const char *opcode_name(opcode op)
+{
+    switch (op) {
+    case op_const: return "const";
+    case op_string: return "string";
+    case op_copy: return "copy";
+    case op_add: return "add";
+    case op_sub: return "sub";
+    case op_mul: return "mul";
+    case op_div: return "div";
+    case op_rem: return "rem";
+    case op_eq: return "eq";
+    case op_ne: return "ne";
+    case op_lt: return "lt";
+    case op_le: return "le";
+    case op_gt: return "gt";
+    case op_ge: return "ge";
+    case op_and: return "and";
+    case op_or: return "or";
+    case op_load: return "load";
+    case op_store: return "store";
+    case op_call: return "call";
+    case op_read: return "read";
+    case op_write: return "write";
+    case op_jump: return "jump";
+    case op_branch: return "branch";
+    case op_ret: return "ret";
+    }
+    return "?";
+}
+
+static const char *type_name(int type)
+{
+    switch (type) {
+    case types::integer: return "int";
+    case types::string: return "str";
+    case types::voidt: return "void";
+    }
+    return "?";
+}
+
+static std::string reg_name(const function &func, vreg r)
+{
+    const auto& info = func.regs[r];
+    if (info.named) {
+        return fmt::sprintf("%%%s.%d", name_of(info.name), r);
+    }
+    return fmt::sprintf("%%%d", r);
+}
+
+void print(std::ostream &out, const module &m, const function &func)
+{
+    out << fmt::sprintf("funcao %s(", name_of(func.name));
+    for (size_t i = 0; i < func.param_count; i++) {
+        out << fmt::sprintf("%s%s: %s", i ? ", " : "",
+                            reg_name(func, static_cast<vreg>(i)),
+                            type_name(func.regs[i].type));
+    }
+    out << fmt::sprintf("): %s\n", type_name(func.ret_type));
+
+    for (size_t b = 0; b < func.blocks.size(); b++) {
+        out << fmt::sprintf("B%d:\n", b);
+        for (const auto& ins : func.blocks[b].code) {
+            out << "    ";
+            if (ins.dst != no_reg) {
+                out << fmt::sprintf("%s: %s = ", reg_name(func, ins.dst),
+                                    type_name(func.regs[ins.dst].type));
+            }
+            out << opcode_name(ins.op);
+            switch (ins.op) {
+            case op_const:
+                out << fmt::sprintf(" %d", ins.imm);
+                break;
+            case op_string:
+                out << fmt::sprintf(" %s", name_of(ins.imm));
+                break;
+            case op_load:
+            case op_store:
+                out << fmt::sprintf(" @%s", name_of(m.globals[ins.imm].name));
+                break;
+            case op_call:
+                out << fmt::sprintf(" %s", name_of(m.functions[ins.imm].name));
+                break;
+            default:
+                break;
+            }
+            bool first = ins.op != op_load && ins.op != op_store &&
+                         ins.op != op_call && ins.op != op_string &&
+                         ins.op != op_const;
+            for_each_operand(ins, [&](vreg r) {
+                out << fmt::sprintf("%s%s", first ? " " : ", ", reg_name(func, r));
+                first = false;
+            });
+            if (ins.op == op_jump) {
+                out << fmt::sprintf(" B%d", ins.target);
+            } else if (ins.op == op_branch) {
+                out << fmt::sprintf(", B%d, B%d", ins.target, ins.alt);
+            }
+            out << "\n";
+        }
+    }
+    out << "\n";
+}
+
+void print(std::ostream &out, const module &m)
+{
+    for (const auto& g : m.globals) {
+        out << fmt::sprintf("global @%s: %s\n", name_of(g.name), type_name(g.type));
+    }
+    if (!m.globals.empty()) {
+        out << "\n";
+        print(out, m, m.init);
+    }
+    for (const auto& func : m.functions) {
+        print(out, m, func);
+    }
+}
+
+} // ir
+} // ptb
@@ -0,0 +1,221 @@
+// -----------------------------------------------------------------------------
+// Pararatibum - A linguagem do momento
+// -----------------------------------------------------------------------------
+
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <vector>
+#include "interner.h"
+#include "types.h"
+
+namespace ptb {
+
+struct symbol;
+
+namespace ir {
+
+// Representação intermediária entre a AST analisada e os geradores de
+// código: cada função é uma lista de blocos básicos de instruções de três
+// endereços sobre registradores virtuais tipados. Todo bloco termina numa
+// instrução de desvio (jump, branch ou ret), então o fluxo de controle é
+// explícito e as otimizações escritas sobre a IR valem para os dois
+// geradores.
+//
+// Os registradores não estão em forma SSA: cada variável local do
+// programa é um registrador com nome, atribuído quantas vezes for preciso,
+// e os valores intermediários das expressões são temporários.
+
+typedef int32_t vreg;
+static const vreg no_reg = -1;
+
+enum opcode : uint8_t {
+    op_const,       // dst = imm
+    op_string,      // dst = literal imm (name_id, com as aspas)
+    op_copy,        // dst = a
+
+    // aritmética de 32 bits
+    op_add,         // dst = a + b
+    op_sub,
+    op_mul,
+    op_div,
+    op_rem,
+
+    // comparações e operadores lógicos, resultado 0 ou 1
+    op_eq,          // dst = a == b
+    op_ne,
+    op_lt,
+    op_le,
+    op_gt,
+    op_ge,
+    // dst = a && b, os dois lados sempre avaliados; só aparece quando b
+    // não tem efeito, senão o curto-circuito vira desvios
+    op_and,
+    op_or,
+
+    op_load,        // dst = global imm
+    op_store,       // global imm = a
+    op_call,        // dst = função imm (args...), dst = no_reg descarta
+    op_read,        // dst = valor lido da entrada
+    op_write,       // escreve a
+
+    // terminadores
+    op_jump,        // vai para target
+    op_branch,      // a != 0 ? target : alt
+    op_ret,         // retorna a (no_reg em funções void)
+};
+
+struct instr {
+    opcode op;
+    // tipo do valor produzido, escrito ou retornado
+    int type;
+    vreg dst;
+    vreg a;
+    vreg b;
+    int32_t imm;
+    int32_t target;
+    int32_t alt;
+    std::vector<vreg> args;
+
+    instr(opcode op_, int type_ = types::voidt) :
+        op(op_), type(type_), dst(no_reg), a(no_reg), b(no_reg),
+        imm(0), target(-1), alt(-1) {
+    }
+
+    bool is_terminator() const { return op >= op_jump; }
+};
+
+struct block {
+    std::vector<instr> code;
+
+    const instr& terminator() const { return code.back(); }
+    instr& terminator() { return code.back(); }
+    bool terminated() const {
+        return !code.empty() && code.back().is_terminator();
+    }
+};
+
+struct reg_info {
+    int type;
+    // nome da variável do programa, apenas se named
+    name_id name;
+    bool named;
+};
+
+struct function {
+    name_id name;
+    symbol *sym;
+    int ret_type;
+    bool is_main;
+    // os parâmetros são sempre os primeiros registradores
+    size_t param_count;
+    std::vector<reg_info> regs;
+    // o bloco 0 é a entrada da função
+    std::vector<block> blocks;
+
+    function() : name(0), sym(nullptr), ret_type(types::voidt),
+        is_main(false), param_count(0) {
+    }
+
+    vreg new_reg(int type) {
+        regs.push_back(reg_info{type, 0, false});
+        return static_cast<vreg>(regs.size() - 1);
+    }
+    vreg new_named_reg(int type, name_id name) {
+        regs.push_back(reg_info{type, name, true});
+        return static_cast<vreg>(regs.size() - 1);
+    }
+    int new_block() {
+        blocks.emplace_back();
+        return static_cast<int>(blocks.size() - 1);
+    }
+};
+
+struct global {
+    name_id name;
+    int type;
+};
+
+struct module {
+    std::vector<global> globals;
+    std::vector<function> functions;
+    // inicialização das variáveis globais, executada antes da função
+    // principal
+    function init;
+};
+
+// Operandos lidos pela instrução, na ordem de avaliação
+template<typename F>
+void for_each_operand(const instr &ins, F f)
+{
+    if (ins.op == op_call) {
+        for (auto arg : ins.args) {
+            f(arg);
+        }
+        return;
+    }
+    if (ins.a != no_reg) {
+        f(ins.a);
+    }
+    if (ins.b != no_reg) {
+        f(ins.b);
+    }
+}
+
+// Blocos sucessores do bloco terminado por ins
+template<typename F>
+void for_each_successor(const instr &ins, F f)
+{
+    if (ins.op == op_jump) {
+        f(ins.target);
+    } else if (ins.op == op_branch) {
+        f(ins.target);
+        if (ins.alt != ins.target) {
+            f(ins.alt);
+        }
+    }
+}
+
+// Os geradores de código recompõem as expressões a partir das instruções:
+// um temporário lido uma única vez, pela instrução que vem logo depois da
+// sua definição no mesmo bloco (descontadas as outras partes da mesma
+// expressão), é calculado dentro da instrução que o lê. Isso vira uma
+// subexpressão no C++ e um valor que fica na pilha na JVM, sem ocupar uma
+// variável local. A ordem de avaliação é sempre a do programa.
+class expr_forest
+{
+public:
+    // calcula as árvores de todos os blocos da função. O C++ não define a
+    // ordem de avaliação dos operandos, então com calls_in_order uma
+    // chamada nunca divide a mesma expressão com partes calculadas antes ou
+    // depois dela (fora as constantes).
+    void build(const function &func, bool calls_in_order = false);
+
+    // a instrução i do bloco b é gerada dentro da instrução que a lê
+    bool is_inlined(int b, size_t i) const {
+        return m_inlined[m_offsets[b] + i] != 0;
+    }
+    // o registrador é um temporário calculado dentro de quem o lê, e nunca
+    // é guardado
+    bool is_inlined_reg(vreg r) const { return m_def_index[r] >= 0; }
+    // instrução que calcula o registrador absorvido
+    const instr& definition(const function &func, vreg r) const {
+        return func.blocks[m_def_block[r]].code[m_def_index[r]];
+    }
+
+private:
+    std::vector<size_t> m_offsets;
+    std::vector<uint8_t> m_inlined;
+    std::vector<int32_t> m_def_block;
+    std::vector<int32_t> m_def_index;
+};
+
+// Listagem textual da IR, para depuração
+void print(std::ostream &out, const module &m);
+void print(std::ostream &out, const module &m, const function &func);
+
+const char *opcode_name(opcode op);
+
+} // ir
+} // ptb
@@ -0,0 +1,495 @@
+// -----------------------------------------------------------------------------
+// Pararatibum - A linguagem do momento
+// -----------------------------------------------------------------------------
+
+// Geração da IR a partir da AST analisada
+
+#include <cppfmt/format.h>
+#include "irbuilder.h"
+#include "tokens.h"
+
+namespace ptb { namespace ir {
+
+builder::builder() : m_module(nullptr), m_function(nullptr), m_block(-1)
+{
+}
+
+void builder::run(const ast::node_ptr &node, module &m)
+{
+    if (node->type != ast::program_node) {
+        throw builder_error("AST nao e um programa valido!");
+    }
+    m = module();
+    m_module = &m;
+    m_functions.clear();
+    m_globals.clear();
+
+    // todas as funções são registradas antes, então uma chamada pode
+    // aparecer antes da definição da função
+    auto program = ast::to_program(node);
+    for (const auto& decl : program->declarations) {
+        if (decl->type == ast::function_decl_node) {
+            declare_function(ast::to_function_decl(decl));
+        }
+    }
+
+    // as variáveis globais são inicializadas na ordem em que aparecem
+    m.init.name = names().intern("@inicializacao");
+    begin_function(&m.init);
+    for (const auto& decl : program->declarations) {
+        if (decl->type == ast::variable_decl_node) {
+            lower_global(ast::to_variable_decl(decl));
+        }
+    }
+    end_function();
+
+    for (const auto& decl : program->declarations) {
+        if (decl->type == ast::function_decl_node) {
+            auto func = ast::to_function_decl(decl);
+            if (!func->is_prototype) {
+                lower_function(func);
+            }
+        }
+    }
+    m_module = nullptr;
+}
+
+void builder::declare_function(ast::function_decl *func)
+{
+    auto& sym = resolved(func->sym, func->name);
+    if (m_functions.count(&sym)) {
+        return;
+    }
+    m_functions[&sym] = static_cast<int>(m_module->functions.size());
+    m_module->functions.emplace_back();
+    auto& f = m_module->functions.back();
+    f.name = func->name;
+    f.sym = &sym;
+    f.is_main = func->is_main();
+    f.ret_type = value_type(sym.c_type());
+    for (const auto& node : func->arguments) {
+        auto arg = ast::to_argument(node);
+        auto& asym = resolved(arg->sym, arg->name);
+        f.new_named_reg(value_type(asym.type), arg->name);
+    }
+    f.param_count = func->arguments.size();
+}
+
+void builder::lower_function(ast::function_decl *func)
+{
+    auto& f = m_module->functions[m_functions[func->sym]];
+    if (!f.blocks.empty()) {
+        throw builder_error(fmt::sprintf("Funcao %s definida mais de uma vez!",
+                                         name_of(func->name)));
+    }
+    begin_function(&f);
+    for (size_t i = 0; i < func->arguments.size() && i < f.param_count; i++) {
+        auto arg = ast::to_argument(func->arguments[i]);
+        m_locals[&resolved(arg->sym, arg->name)] = static_cast<vreg>(i);
+    }
+    lower_stmts(func->statements);
+    end_function();
+}
+
+void builder::lower_global(ast::variable_decl *var)
+{
+    auto& sym = resolved(var->sym, var->name);
+    if (!m_globals.count(&sym)) {
+        m_globals[&sym] = static_cast<int>(m_module->globals.size());
+        m_module->globals.push_back(global{sym.name, value_type(sym.type)});
+    }
+    vreg value = var->value->is_valid() ? lower_expr(var->value)
+                                        : lower_default(value_type(sym.type));
+    store(&sym, value);
+}
+
+void builder::begin_function(function *func)
+{
+    m_function = func;
+    m_locals.clear();
+    m_layout.clear();
+    set_block(func->new_block());
+}
+
+// Fecha o último bloco e ordena os blocos na ordem em que o código foi
+// gerado, que é a ordem do programa
+void builder::end_function()
+{
+    auto& f = *m_function;
+    if (m_block >= 0) {
+        instr ret(op_ret, f.ret_type);
+        if (f.ret_type != types::voidt && !f.is_main) {
+            ret.a = lower_default(f.ret_type);
+        } else {
+            ret.type = types::voidt;
+        }
+        emit(ret);
+    }
+
+    std::vector<int32_t> index(f.blocks.size(), -1);
+    for (size_t i = 0; i < m_layout.size(); i++) {
+        index[m_layout[i]] = static_cast<int32_t>(i);
+    }
+    std::vector<block> blocks;
+    blocks.reserve(m_layout.size());
+    for (auto b : m_layout) {
+        blocks.push_back(std::move(f.blocks[b]));
+        auto& term = blocks.back().terminator();
+        if (term.op == op_jump || term.op == op_branch) {
+            term.target = index[term.target];
+            term.alt = term.op == op_branch ? index[term.alt] : -1;
+        }
+    }
+    f.blocks = std::move(blocks);
+    m_function = nullptr;
+}
+
+void builder::set_block(int b)
+{
+    m_block = b;
+    m_layout.push_back(b);
+}
+
+void builder::lower_stmts(const ast::node_list &stmts)
+{
+    for (const auto& stmt : stmts) {
+        lower_stmt(stmt);
+    }
+}
+
+void builder::lower_stmt(const ast::node_ptr &node)
+{
+    switch (node->type) {
+    case ast::variable_decl_node: lower_variable_decl(ast::to_variable_decl(node)); break;
+    case ast::assign_stmt_node: lower_assign(ast::to_assign_stmt(node)); break;
+    case ast::if_stmt_node: lower_if(ast::to_if_stmt(node)); break;
+    case ast::while_stmt_node: lower_while(ast::to_while_stmt(node)); break;
+    case ast::return_stmt_node: lower_return(ast::to_return_stmt(node)); break;
+    case ast::read_stmt_node: lower_read(ast::to_read_stmt(node)); break;
+    case ast::write_stmt_node: lower_write(ast::to_write_stmt(node)); break;
+    case ast::call_node: lower_call(ast::to_call(node), true); break;
+    default: break;
+    }
+}
+
+void builder::lower_if(ast::if_stmt *ifstmt)
+{
+    int true_block = m_function->new_block();
+    int false_block = ifstmt->false_statements.empty() ? -1 : m_function->new_block();
+    int end_block = m_function->new_block();
+    lower_cond(ifstmt->eval_expr, true_block, false_block >= 0 ? false_block : end_block);
+
+    set_block(true_block);
+    lower_stmts(ifstmt->true_statements);
+    emit_jump(end_block);
+    if (false_block >= 0) {
+        set_block(false_block);
+        lower_stmts(ifstmt->false_statements);
+        emit_jump(end_block);
+    }
+    set_block(end_block);
+}
+
+void builder::lower_while(ast::while_stmt *whilestmt)
+{
+    int cond_block = m_function->new_block();
+    int body_block = m_function->new_block();
+    int end_block = m_function->new_block();
+
+    emit_jump(cond_block);
+    set_block(cond_block);
+    lower_cond(whilestmt->eval_expr, body_block, end_block);
+
+    set_block(body_block);
+    lower_stmts(whilestmt->statements);
+    emit_jump(cond_block);
+    set_block(end_block);
+}
+
+void builder::lower_return(ast::return_stmt *ret)
+{
+    instr ins(op_ret, m_function->ret_type);
+    if (ret->expr->is_valid()) {
+        ins.a = lower_expr(ret->expr);
+    }
+    // a função principal e as funções void descartam o valor
+    if (m_function->is_main || m_function->ret_type == types::voidt) {
+        ins.a = no_reg;
+        ins.type = types::voidt;
+    } else if (ins.a == no_reg) {
+        ins.a = lower_default(m_function->ret_type);
+    }
+    emit(ins);
+}
+
+void builder::lower_variable_decl(ast::variable_decl *var)
+{
+    auto& sym = resolved(var->sym, var->name);
+    vreg value = var->value->is_valid() ? lower_expr(var->value)
+                                        : lower_default(value_type(sym.type));
+    store(&sym, value);
+}
+
+void builder::lower_assign(ast::assign_stmt *assign)
+{
+    auto lvalue = ast::to_variable(assign->lvalue);
+    auto& sym = resolved(lvalue->sym, lvalue->name);
+    store(&sym, lower_expr(assign->rvalue));
+}
+
+void builder::lower_read(ast::read_stmt *read)
+{
+    auto& sym = resolved(read->sym, read->identifier);
+    instr ins(op_read, value_type(sym.type));
+    if (m_globals.count(&sym)) {
+        store(&sym, emit_value(ins));
+    } else {
+        ins.dst = local(&sym);
+        emit(ins);
+    }
+}
+
+void builder::lower_write(ast::write_stmt *write)
+{
+    instr ins(op_write, value_type(write->expr->eval_type));
+    ins.a = lower_expr(write->expr);
+    emit(ins);
+}
+
+vreg builder::lower_expr(const ast::node_ptr &node)
+{
+    switch (node->type) {
+    case ast::integer_node: {
+        instr ins(op_const, types::integer);
+        ins.imm = ast::to_integer(node)->value;
+        return emit_value(ins);
+    }
+    case ast::string_node: {
+        instr ins(op_string, types::string);
+        ins.imm = static_cast<int32_t>(ast::to_lstring(node)->value);
+        return emit_value(ins);
+    }
+    case ast::variable_node: {
+        auto var = ast::to_variable(node);
+        auto& sym = resolved(var->sym, var->name);
+        auto global = m_globals.find(&sym);
+        if (global != m_globals.end()) {
+            instr ins(op_load, value_type(sym.type));
+            ins.imm = global->second;
+            return emit_value(ins);
+        }
+        return local(&sym);
+    }
+    case ast::call_node:
+        return lower_call(ast::to_call(node), false);
+    case ast::op_arithm_node: {
+        auto op = ast::to_op_arithm(node);
+        instr ins(op_add, types::integer);
+        switch (op->op) {
+        case '+': ins.op = op_add; break;
+        case '-': ins.op = op_sub; break;
+        case '*': ins.op = op_mul; break;
+        case '/': ins.op = op_div; break;
+        case '%': ins.op = op_rem; break;
+        default:
+            throw builder_error(fmt::sprintf("Operacao aritmetica invalida %c", op->op));
+        }
+        ins.a = lower_expr(op->left);
+        ins.b = lower_expr(op->right);
+        return emit_value(ins);
+    }
+    case ast::op_logical_node: {
+        auto op = ast::to_op_logical(node);
+        instr ins(op_eq, types::integer);
+        switch (op->op) {
+        case tok::eq: ins.op = op_eq; break;
+        case tok::ne: ins.op = op_ne; break;
+        case tok::lt: ins.op = op_lt; break;
+        case tok::le: ins.op = op_le; break;
+        case tok::gt: ins.op = op_gt; break;
+        case tok::ge: ins.op = op_ge; break;
+        case tok::b_and: ins.op = op_and; break;
+        case tok::b_or: ins.op = op_or; break;
+        default:
+            throw builder_error(fmt::sprintf("Operacao logica invalida %s", token_name[op->op]));
+        }
+        // avaliar o lado direito sempre só é equivalente ao curto-circuito
+        // quando ele não chama funções nem pode dividir por zero
+        if ((ins.op == op_and || ins.op == op_or) && !ast::is_pure(op->right)) {
+            return lower_short_circuit(node);
+        }
+        ins.a = lower_expr(op->left);
+        ins.b = lower_expr(op->right);
+        return emit_value(ins);
+    }
+    default:
+        throw builder_error(fmt::sprintf("Expressao invalida para traducao %d", static_cast<int>(node->type)));
+    }
+}
+
+void builder::lower_cond(const ast::node_ptr &node, int true_block, int false_block)
+{
+    if (node->type == ast::op_logical_node) {
+        auto op = ast::to_op_logical(node);
+        if (op->op == tok::b_and || op->op == tok::b_or) {
+            // o lado direito só é avaliado se o esquerdo não decidir
+            int right_block = m_function->new_block();
+            if (op->op == tok::b_and) {
+                lower_cond(op->left, right_block, false_block);
+            } else {
+                lower_cond(op->left, true_block, right_block);
+            }
+            set_block(right_block);
+            lower_cond(op->right, true_block, false_block);
+            return;
+        }
+    }
+    emit_branch(lower_expr(node), true_block, false_block);
+}
+
+// Valor 0 ou 1 de um eu/tu calculado com desvios
+vreg builder::lower_short_circuit(const ast::node_ptr &node)
+{
+    vreg result = m_function->new_reg(types::integer);
+    int true_block = m_function->new_block();
+    int false_block = m_function->new_block();
+    int end_block = m_function->new_block();
+    lower_cond(node, true_block, false_block);
+
+    instr value(op_const, types::integer);
+    value.dst = result;
+    set_block(true_block);
+    value.imm = 1;
+    emit(value);
+    emit_jump(end_block);
+    set_block(false_block);
+    value.imm = 0;
+    emit(value);
+    emit_jump(end_block);
+    set_block(end_block);
+    return result;
+}
+
+vreg builder::lower_call(ast::call *call, bool discard)
+{
+    auto& sym = resolved(call->sym, call->name);
+    auto func = m_functions.find(&sym);
+    if (func == m_functions.end()) {
+        throw builder_error(fmt::sprintf("Funcao %s nao declarada!", name_of(call->name)));
+    }
+    instr ins(op_call, m_module->functions[func->second].ret_type);
+    ins.imm = func->second;
+    for (const auto& param : call->param_list) {
+        ins.args.push_back(lower_expr(param));
+    }
+    if (discard) {
+        emit(ins);
+        return no_reg;
+    }
+    if (ins.type == types::voidt) {
+        throw builder_error(fmt::sprintf("Funcao %s nao retorna valor!", name_of(call->name)));
+    }
+    return emit_value(ins);
+}
+
+// Valor inicial de uma variável declarada sem valor
+vreg builder::lower_default(int type)
+{
+    if (type == types::string) {
+        instr ins(op_string, types::string);
+        ins.imm = static_cast<int32_t>(names().intern("\"\""));
+        return emit_value(ins);
+    }
+    instr ins(op_const, types::integer);
+    return emit_value(ins);
+}
+
+void builder::store(symbol *sym, vreg value)
+{
+    auto global = m_globals.find(sym);
+    if (global != m_globals.end()) {
+        instr ins(op_store, m_module->globals[global->second].type);
+        ins.imm = global->second;
+        ins.a = value;
+        emit(ins);
+        return;
+    }
+    vreg dst = local(sym);
+    instr ins(op_copy, m_function->regs[dst].type);
+    ins.dst = dst;
+    ins.a = value;
+    emit(ins);
+}
+
+vreg builder::local(symbol *sym)
+{
+    auto it = m_locals.find(sym);
+    if (it != m_locals.end()) {
+        return it->second;
+    }
+    vreg r = m_function->new_named_reg(value_type(sym->type), sym->name);
+    m_locals[sym] = r;
+    return r;
+}
+
+// Símbolo ligado ao nó pelo analisador semântico
+symbol& builder::resolved(symbol *sym, name_id name)
+{
+    if (sym == nullptr) {
+        throw builder_error(fmt::sprintf("%s simbolo nao encontrado!", name_of(name)));
+    }
+    return *sym;
+}
+
+// Tipos representados na IR: caractéres e booleanos são inteiros
+int builder::value_type(int type)
+{
+    type &= ~types::function;
+    if (type == types::string || type == types::voidt) {
+        return type;
+    }
+    return types::integer;
+}
+
+instr& builder::emit(const instr &ins)
+{
+    // código depois de um desvio fica num bloco próprio, inalcançável
+    if (m_block < 0) {
+        set_block(m_function->new_block());
+    }
+    auto& code = m_function->blocks[m_block].code;
+    code.push_back(ins);
+    if (ins.is_terminator()) {
+        m_block = -1;
+    }
+    return code.back();
+}
+
+vreg builder::emit_value(instr ins)
+{
+    ins.dst = m_function->new_reg(ins.type);
+    emit(ins);
+    return ins.dst;
+}
+
+void builder::emit_jump(int target)
+{
+    if (m_block < 0) {
+        return;
+    }
+    instr ins(op_jump);
+    ins.target = target;
+    emit(ins);
+}
+
+void builder::emit_branch(vreg cond, int true_block, int false_block)
+{
+    instr ins(op_branch);
+    ins.a = cond;
+    ins.target = true_block;
+    ins.alt = false_block;
+    emit(ins);
+}
+
+} // ir
+} // ptb
@@ -0,0 +1,81 @@
+// -----------------------------------------------------------------------------
+// Pararatibum - A linguagem do momento
+// -----------------------------------------------------------------------------
+
+#pragma once
+
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "ast.h"
+#include "ir.h"
+#include "symtable.h"
+
+namespace ptb { namespace ir {
+
+struct builder_error : public std::runtime_error {
+    builder_error(const std::string& w) : std::runtime_error(w) {
+    }
+};
+
+// Traduz a AST analisada (com os símbolos ligados e os tipos calculados)
+// para a IR
+class builder
+{
+public:
+    builder();
+
+    void run(const ast::node_ptr &program, module &m);
+
+private:
+    void declare_function(ast::function_decl *func);
+    void lower_function(ast::function_decl *func);
+    void lower_global(ast::variable_decl *var);
+    void begin_function(function *func);
+    void end_function();
+
+    void lower_stmts(const ast::node_list &stmts);
+    void lower_stmt(const ast::node_ptr &node);
+    void lower_if(ast::if_stmt *ifstmt);
+    void lower_while(ast::while_stmt *whilestmt);
+    void lower_return(ast::return_stmt *ret);
+    void lower_variable_decl(ast::variable_decl *var);
+    void lower_assign(ast::assign_stmt *assign);
+    void lower_read(ast::read_stmt *read);
+    void lower_write(ast::write_stmt *write);
+
+    vreg lower_expr(const ast::node_ptr &node);
+    // desvia para true_block ou false_block conforme a condição, avaliando
+    // eu/tu em curto-circuito
+    void lower_cond(const ast::node_ptr &node, int true_block, int false_block);
+    vreg lower_short_circuit(const ast::node_ptr &node);
+    vreg lower_call(ast::call *call, bool discard);
+    vreg lower_default(int type);
+
+    // grava o valor na variável local ou global do símbolo
+    void store(symbol *sym, vreg value);
+    vreg local(symbol *sym);
+    symbol& resolved(symbol *sym, name_id name);
+    static int value_type(int type);
+
+    instr& emit(const instr &ins);
+    vreg emit_value(instr ins);
+    void emit_jump(int target);
+    void emit_branch(vreg cond, int true_block, int false_block);
+    void set_block(int b);
+
+    module *m_module;
+    function *m_function;
+    // bloco atual, -1 depois de um desvio (o código seguinte é inalcançável)
+    int m_block;
+    // blocos na ordem em que foram iniciados
+    std::vector<int> m_layout;
+
+    std::unordered_map<const symbol*, int> m_functions;
+    std::unordered_map<const symbol*, int> m_globals;
+    std::unordered_map<const symbol*, vreg> m_locals;
+};
+
+} // ir
+} // ptb
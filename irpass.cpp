@@ -0,0 +1,358 @@
+// -----------------------------------------------------------------------------
+// Pararatibum - A linguagem do momento
+// -----------------------------------------------------------------------------
+
+#include <climits>
+#include "cfg.h"
+#include "dataflow.h"
+#include "irpass.h"
+#include "timing.h"
+
+namespace ptb { namespace ir {
+
+void pass_manager::add(std::unique_ptr<pass> p)
+{
+    m_passes.push_back(std::move(p));
+}
+
+void pass_manager::run(module &m)
+{
+    run(m.init);
+    for (auto& func : m.functions) {
+        // funções apenas prototipadas não têm código
+        if (!func.blocks.empty()) {
+            run(func);
+        }
+    }
+}
+
+bool pass_manager::run(function &func)
+{
+    bool changed = false;
+    for (auto& p : m_passes) {
+        scoped_timer timer(p->name());
+        changed |= p->run(func);
+    }
+    return changed;
+}
+
+void compact_blocks(function &func, const std::vector<uint8_t> &keep)
+{
+    std::vector<int32_t> index(func.blocks.size(), -1);
+    size_t count = 0;
+    for (size_t b = 0; b < func.blocks.size(); b++) {
+        if (keep[b]) {
+            index[b] = static_cast<int32_t>(count);
+            if (count != b) {
+                func.blocks[count] = std::move(func.blocks[b]);
+            }
+            count++;
+        }
+    }
+    func.blocks.resize(count);
+    for (auto& blk : func.blocks) {
+        auto& term = blk.terminator();
+        if (term.op == op_jump || term.op == op_branch) {
+            term.target = index[term.target];
+        }
+        if (term.op == op_branch) {
+            term.alt = index[term.alt];
+        }
+    }
+}
+
+bool remove_unreachable::run(function &func)
+{
+    std::vector<uint8_t> reached(func.blocks.size(), 0);
+    std::vector<int32_t> work;
+    reached[0] = 1;
+    work.push_back(0);
+    while (!work.empty()) {
+        int32_t b = work.back();
+        work.pop_back();
+        for_each_successor(func.blocks[b].terminator(), [&](int32_t s) {
+            if (!reached[s]) {
+                reached[s] = 1;
+                work.push_back(s);
+            }
+        });
+    }
+    for (auto r : reached) {
+        if (!r) {
+            compact_blocks(func, reached);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool simplify_cfg::run(function &func)
+{
+    bool changed = false;
+    size_t count = func.blocks.size();
+
+    // destino final de cada bloco que contém apenas um salto
+    std::vector<int32_t> forward(count);
+    for (size_t b = 0; b < count; b++) {
+        forward[b] = static_cast<int32_t>(b);
+    }
+    for (size_t b = 1; b < count; b++) {
+        const auto& code = func.blocks[b].code;
+        if (code.size() == 1 && code[0].op == op_jump) {
+            forward[b] = code[0].target;
+        }
+    }
+    auto resolve = [&](int32_t b) {
+        // limita o percurso para não entrar em laços de saltos vazios
+        for (size_t steps = 0; forward[b] != b && steps < count; steps++) {
+            b = forward[b];
+        }
+        return b;
+    };
+    for (auto& blk : func.blocks) {
+        auto& term = blk.terminator();
+        if (term.op == op_jump || term.op == op_branch) {
+            int32_t target = resolve(term.target);
+            changed |= target != term.target;
+            term.target = target;
+        }
+        if (term.op == op_branch) {
+            int32_t alt = resolve(term.alt);
+            changed |= alt != term.alt;
+            term.alt = alt;
+            if (term.target == term.alt) {
+                // a condição fica sem uso, mas ainda é avaliada
+                term.op = op_jump;
+                term.a = no_reg;
+                term.alt = -1;
+                changed = true;
+            }
+        }
+    }
+
+    std::vector<uint32_t> preds(count, 0);
+    for (const auto& blk : func.blocks) {
+        for_each_successor(blk.terminator(), [&](int32_t s) { preds[s]++; });
+    }
+    std::vector<uint8_t> keep(count, 1);
+    for (size_t b = 0; b < count; b++) {
+        if (!keep[b]) {
+            continue;
+        }
+        auto& code = func.blocks[b].code;
+        while (code.back().op == op_jump) {
+            int32_t s = code.back().target;
+            if (s == 0 || s == static_cast<int32_t>(b) || preds[s] != 1) {
+                break;
+            }
+            auto& next = func.blocks[s].code;
+            code.pop_back();
+            code.insert(code.end(), next.begin(), next.end());
+            next.clear();
+            keep[s] = 0;
+            changed = true;
+        }
+    }
+    for (size_t b = 0; b < count; b++) {
+        if (!keep[b]) {
+            // recoloca um terminador para manter o bloco bem formado até a
+            // compactação
+            func.blocks[b].code.assign(1, instr(op_ret));
+        }
+    }
+    compact_blocks(func, keep);
+
+    remove_unreachable cleanup;
+    changed |= cleanup.run(func);
+    return changed;
+}
+
+// Valor constante do registrador no ponto em que as definições em reach o
+// alcançam: todas precisam ser a mesma constante (op_const ou op_string).
+// Se a definição da entrada alcança o ponto, algum caminho chega sem
+// escrever no registrador e o valor é desconhecido (o argumento, num
+// parâmetro).
+static bool constant_of(const function &func, const reaching_defs &defs,
+                        const bitvector &reach, vreg r, opcode &kind,
+                        int32_t &value)
+{
+    bool found = false;
+    for (auto d : defs.defs_of(r)) {
+        if (!reach.test(d)) {
+            continue;
+        }
+        const auto& site = defs.sites()[d];
+        if (site.is_entry()) {
+            return false;
+        }
+        const auto& def = func.blocks[site.block].code[site.index];
+        if (def.op != op_const && def.op != op_string) {
+            return false;
+        }
+        if (found && (def.op != kind || def.imm != value)) {
+            return false;
+        }
+        kind = def.op;
+        value = def.imm;
+        found = true;
+    }
+    return found;
+}
+
+// Avalia a operação com a aritmética de 32 bits da JVM, como o optimizer
+// faz na AST; a divisão por zero fica para a execução
+static bool fold_binary(opcode op, int32_t lhs, int32_t rhs, int32_t &result)
+{
+    uint32_t ul = static_cast<uint32_t>(lhs);
+    uint32_t ur = static_cast<uint32_t>(rhs);
+    switch (op) {
+    case op_add: result = static_cast<int32_t>(ul + ur); return true;
+    case op_sub: result = static_cast<int32_t>(ul - ur); return true;
+    case op_mul: result = static_cast<int32_t>(ul * ur); return true;
+    case op_div:
+    case op_rem:
+        if (rhs == 0) {
+            return false;
+        }
+        if (lhs == INT_MIN && rhs == -1) {
+            result = op == op_div ? INT_MIN : 0;
+        } else {
+            result = op == op_div ? lhs / rhs : lhs % rhs;
+        }
+        return true;
+    case op_eq: result = lhs == rhs; return true;
+    case op_ne: result = lhs != rhs; return true;
+    case op_lt: result = lhs < rhs; return true;
+    case op_le: result = lhs <= rhs; return true;
+    case op_gt: result = lhs > rhs; return true;
+    case op_ge: result = lhs >= rhs; return true;
+    case op_and: result = lhs != 0 && rhs != 0; return true;
+    case op_or: result = lhs != 0 || rhs != 0; return true;
+    default:
+        return false;
+    }
+}
+
+static bool fold_instr(const function &func, const reaching_defs &defs,
+                       const bitvector &reach, instr &ins)
+{
+    opcode kind = op_const, rkind = op_const;
+    int32_t value = 0, rvalue = 0;
+    switch (ins.op) {
+    case op_copy:
+        if (!constant_of(func, defs, reach, ins.a, kind, value)) {
+            return false;
+        }
+        ins.op = kind;
+        ins.imm = value;
+        ins.a = no_reg;
+        return true;
+    case op_branch:
+        if (!constant_of(func, defs, reach, ins.a, kind, value) ||
+            kind != op_const) {
+            return false;
+        }
+        // o bloco que deixa de ser alcançado é removido pelo simplify_cfg
+        ins.op = op_jump;
+        ins.target = value ? ins.target : ins.alt;
+        ins.alt = -1;
+        ins.a = no_reg;
+        return true;
+    default:
+        break;
+    }
+    if (ins.a == no_reg || ins.b == no_reg ||
+        !constant_of(func, defs, reach, ins.a, kind, value) ||
+        !constant_of(func, defs, reach, ins.b, rkind, rvalue) ||
+        kind != op_const || rkind != op_const ||
+        !fold_binary(ins.op, value, rvalue, value)) {
+        return false;
+    }
+    ins.op = op_const;
+    ins.imm = value;
+    ins.a = no_reg;
+    ins.b = no_reg;
+    return true;
+}
+
+bool propagate_constants::run(function &func)
+{
+    cfg graph;
+    graph.build(func);
+    reaching_defs defs;
+    defs.compute(func, graph);
+
+    // as definições não mudam de lugar, só viram constantes, então a
+    // mesma análise serve até não haver mais o que substituir; os desvios
+    // transformados em saltos só deixam o resultado mais conservador
+    bool changed = false;
+    bool again = true;
+    while (again) {
+        again = false;
+        for (auto b : graph.reverse_postorder()) {
+            auto& code = func.blocks[b].code;
+            defs.forward(func, b, [&](size_t i, const bitvector &reach) {
+                again |= fold_instr(func, defs, reach, code[i]);
+            });
+        }
+        changed |= again;
+    }
+    return changed;
+}
+
+static bool removable(const instr &ins)
+{
+    switch (ins.op) {
+    case op_call:
+    case op_read:
+    case op_div:
+    case op_rem:
+        return false;
+    default:
+        return ins.dst != no_reg;
+    }
+}
+
+bool eliminate_dead_code::run(function &func)
+{
+    cfg graph;
+    graph.build(func);
+    liveness live;
+    bool changed = false;
+    bool again = true;
+    // remover uma instrução num bloco pode matar valores que chegam de
+    // outro, então recalcula até não haver mudança
+    while (again) {
+        again = false;
+        live.compute(func, graph);
+        for (size_t b = 0; b < func.blocks.size(); b++) {
+            auto& code = func.blocks[b].code;
+            bitvector alive = live.live_out(static_cast<int32_t>(b));
+            std::vector<uint8_t> dead(code.size(), 0);
+            for (size_t i = code.size(); i-- > 0;) {
+                if (removable(code[i]) && !alive.test(code[i].dst)) {
+                    // os operandos de uma instrução removida não ficam vivos
+                    dead[i] = 1;
+                    again = true;
+                    continue;
+                }
+                liveness::step(code[i], alive);
+            }
+            size_t count = 0;
+            for (size_t i = 0; i < code.size(); i++) {
+                if (!dead[i]) {
+                    if (count != i) {
+                        code[count] = std::move(code[i]);
+                    }
+                    count++;
+                }
+            }
+            code.erase(code.begin() + count, code.end());
+        }
+        changed |= again;
+    }
+    return changed;
+}
+
+} // ir
+} // ptb
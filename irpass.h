@@ -0,0 +1,83 @@
+// -----------------------------------------------------------------------------
+// Pararatibum - A linguagem do momento
+// -----------------------------------------------------------------------------
+
+#pragma once
+
+#include <memory>
+#include <vector>
+#include "ir.h"
+
+namespace ptb { namespace ir {
+
+// Uma transformação sobre a IR de uma função
+class pass
+{
+public:
+    virtual ~pass() {}
+    virtual const char *name() const = 0;
+    // devolve true se a função foi modificada
+    virtual bool run(function &func) = 0;
+};
+
+// Executa uma sequência de passes sobre todas as funções do módulo, na
+// ordem em que foram adicionados
+class pass_manager
+{
+public:
+    void add(std::unique_ptr<pass> p);
+    template<typename T>
+    void add() { add(std::unique_ptr<pass>(new T())); }
+
+    void run(module &m);
+    bool run(function &func);
+
+private:
+    std::vector<std::unique_ptr<pass>> m_passes;
+};
+
+// Remove os blocos que não podem ser alcançados a partir da entrada
+class remove_unreachable : public pass
+{
+public:
+    const char *name() const override { return "remove_unreachable"; }
+    bool run(function &func) override;
+};
+
+// Desvia os saltos que passam por blocos vazios direto para o destino
+// final e junta cada bloco ao seu único predecessor quando este termina
+// num salto incondicional para ele
+class simplify_cfg : public pass
+{
+public:
+    const char *name() const override { return "simplify_cfg"; }
+    bool run(function &func) override;
+};
+
+// Substitui por constantes os valores que só podem vir de constantes: uma
+// cópia ou operação cujos operandos têm todas as definições que os
+// alcançam iguais à mesma constante, e desvios com condição constante.
+// Usa as definições que alcançam cada instrução (reaching_defs).
+class propagate_constants : public pass
+{
+public:
+    const char *name() const override { return "propagate_constants"; }
+    bool run(function &func) override;
+};
+
+// Remove as instruções sem efeito cujo resultado não está vivo depois
+// delas (liveness). Chamadas, leituras da entrada e divisões, que podem
+// falhar, são sempre mantidas.
+class eliminate_dead_code : public pass
+{
+public:
+    const char *name() const override { return "eliminate_dead_code"; }
+    bool run(function &func) override;
+};
+
+// Mantém apenas os blocos marcados em keep, na mesma ordem, e renumera os
+// destinos dos desvios
+void compact_blocks(function &func, const std::vector<uint8_t> &keep);
+
+} // ir
+} // ptb
@@ -0,0 +1,300 @@
+// -----------------------------------------------------------------------------
+// Pararatibum - A linguagem do momento
+// -----------------------------------------------------------------------------
+
+#include <algorithm>
+#include <cppfmt/format.h>
+#include "jvmasm.h"
+
+namespace ptb { namespace jvm {
+
+const char *mnemonic(opcode op)
+{
+    switch (op) {
+    case op_label: return "";
+    case op_iconst: return "iconst";
+    case op_ldc_string: return "ldc";
+    case op_iload: return "iload";
+    case op_istore: return "istore";
+    case op_aload: return "aload";
+    case op_astore: return "astore";
+    case op_iinc: return "iinc";
+    case op_iadd: return "iadd";
+    case op_isub: return "isub";
+    case op_imul: return "imul";
+    case op_idiv: return "idiv";
+    case op_irem: return "irem";
+    case op_iand: return "iand";
+    case op_ior: return "ior";
+    case op_ifeq: return "ifeq";
+    case op_ifne: return "ifne";
+    case op_if_icmpeq: return "if_icmpeq";
+    case op_if_icmpne: return "if_icmpne";
+    case op_if_icmplt: return "if_icmplt";
+    case op_if_icmple: return "if_icmple";
+    case op_if_icmpgt: return "if_icmpgt";
+    case op_if_icmpge: return "if_icmpge";
+    case op_goto: return "goto";
+    case op_getstatic: return "getstatic";
+    case op_putstatic: return "putstatic";
+    case op_invokestatic: return "invokestatic";
+    case op_invokevirtual: return "invokevirtual";
+    case op_invokespecial: return "invokespecial";
+    case op_new: return "new";
+    case op_dup: return "dup";
+    case op_pop: return "pop";
+    case op_ireturn: return "ireturn";
+    case op_areturn: return "areturn";
+    case op_return: return "return";
+    }
+    return "?";
+}
+
+opcode negated(opcode op)
+{
+    switch (op) {
+    case op_ifeq: return op_ifne;
+    case op_ifne: return op_ifeq;
+    case op_if_icmpeq: return op_if_icmpne;
+    case op_if_icmpne: return op_if_icmpeq;
+    case op_if_icmplt: return op_if_icmpge;
+    case op_if_icmpge: return op_if_icmplt;
+    case op_if_icmple: return op_if_icmpgt;
+    case op_if_icmpgt: return op_if_icmple;
+    default:
+        throw jvmasm_error(fmt::sprintf("%s nao e um desvio condicional", mnemonic(op)));
+    }
+}
+
+void method_code::clear(int first_label)
+{
+    m_code.clear();
+    m_next_label = first_label;
+}
+
+void method_code::emit_ref(opcode op, const std::string &owner,
+                           const std::string &name, const std::string &desc)
+{
+    m_code.emplace_back(op);
+    auto& ins = m_code.back();
+    ins.owner = owner;
+    ins.name = name;
+    ins.desc = desc;
+}
+
+void method_code::emit_string(const std::string &literal)
+{
+    m_code.emplace_back(op_ldc_string);
+    m_code.back().name = literal;
+}
+
+void describe_method(const std::string &desc, int &args, bool &returns)
+{
+    args = 0;
+    size_t i = 1;
+    while (i < desc.size() && desc[i] != ')') {
+        while (desc[i] == '[') {
+            i++;
+        }
+        if (desc[i] == 'L') {
+            i = desc.find(';', i);
+        }
+        i++;
+        args++;
+    }
+    returns = i + 1 < desc.size() && desc[i + 1] != 'V';
+}
+
+void stack_effect(const insn &ins, int &pops, int &pushes)
+{
+    pops = 0;
+    pushes = 0;
+    switch (ins.op) {
+    case op_label:
+    case op_iinc:
+    case op_goto:
+    case op_return:
+        break;
+    case op_iconst:
+    case op_ldc_string:
+    case op_iload:
+    case op_aload:
+    case op_getstatic:
+    case op_new:
+        pushes = 1;
+        break;
+    case op_istore:
+    case op_astore:
+    case op_putstatic:
+    case op_ifeq:
+    case op_ifne:
+    case op_pop:
+    case op_ireturn:
+    case op_areturn:
+        pops = 1;
+        break;
+    case op_iadd:
+    case op_isub:
+    case op_imul:
+    case op_idiv:
+    case op_irem:
+    case op_iand:
+    case op_ior:
+        pops = 2;
+        pushes = 1;
+        break;
+    case op_if_icmpeq:
+    case op_if_icmpne:
+    case op_if_icmplt:
+    case op_if_icmple:
+    case op_if_icmpgt:
+    case op_if_icmpge:
+        pops = 2;
+        break;
+    case op_dup:
+        pops = 1;
+        pushes = 2;
+        break;
+    case op_invokestatic:
+    case op_invokevirtual:
+    case op_invokespecial: {
+        bool returns;
+        describe_method(ins.desc, pops, returns);
+        // o objeto que recebe a chamada
+        if (ins.op != op_invokestatic) {
+            pops++;
+        }
+        pushes = returns ? 1 : 0;
+        break;
+    }
+    }
+}
+
+// A profundidade da pilha antes de cada instrução é a mesma em todos os
+// caminhos que chegam até ela (a JVM exige isso), então basta propagar a
+// profundidade da entrada pelos desvios e pela sequência até visitar todas
+// as instruções alcançáveis
+int method_code::max_stack() const
+{
+    std::vector<int> labels;
+    for (size_t i = 0; i < m_code.size(); i++) {
+        if (m_code[i].op == op_label) {
+            auto label = static_cast<size_t>(m_code[i].arg);
+            if (label >= labels.size()) {
+                labels.resize(label + 1, -1);
+            }
+            labels[label] = static_cast<int>(i);
+        }
+    }
+
+    std::vector<int> depth(m_code.size(), -1);
+    std::vector<size_t> work;
+    int max_depth = 0;
+    auto reach = [&](size_t i, int d) {
+        if (i >= m_code.size()) {
+            return;
+        }
+        if (depth[i] < 0) {
+            depth[i] = d;
+            work.push_back(i);
+        } else if (depth[i] != d) {
+            throw jvmasm_error(fmt::sprintf(
+                "Pilha inconsistente na instrucao %d: %d ou %d valores", i, depth[i], d));
+        }
+    };
+    reach(0, 0);
+    while (!work.empty()) {
+        size_t i = work.back();
+        work.pop_back();
+        // segue a sequência até um desvio incondicional ou uma instrução
+        // já visitada
+        for (int d = depth[i];;) {
+            const auto& ins = m_code[i];
+            int pops, pushes;
+            stack_effect(ins, pops, pushes);
+            if (d < pops) {
+                throw jvmasm_error(fmt::sprintf(
+                    "Pilha vazia na instrucao %d (%s)", i, mnemonic(ins.op)));
+            }
+            d += pushes - pops;
+            max_depth = std::max(max_depth, d);
+            if (ins.is_branch()) {
+                auto label = static_cast<size_t>(ins.arg);
+                if (label >= labels.size() || labels[label] < 0) {
+                    throw jvmasm_error(fmt::sprintf("Rotulo L%d nao definido", ins.arg));
+                }
+                reach(static_cast<size_t>(labels[label]), d);
+            }
+            if (ins.ends_flow() || ++i >= m_code.size()) {
+                break;
+            }
+            if (depth[i] >= 0) {
+                reach(i, d);
+                break;
+            }
+            depth[i] = d;
+        }
+    }
+    return max_depth;
+}
+
+void method_code::write_jasmin(std::ostream &out) const
+{
+    for (const auto& ins : m_code) {
+        switch (ins.op) {
+        case op_label:
+            out << fmt::sprintf("L%d:\n", ins.arg);
+            break;
+        case op_iconst:
+            if (ins.arg >= 0 && ins.arg <= 5) {
+                out << fmt::sprintf("iconst_%d\n", ins.arg);
+            } else if (ins.arg == -1) {
+                out << fmt::sprintf("iconst_m1\n");
+            } else {
+                out << fmt::sprintf("ldc %d\n", ins.arg);
+            }
+            break;
+        case op_ldc_string:
+            out << fmt::sprintf("ldc %s\n", ins.name);
+            break;
+        case op_iload:
+        case op_istore:
+        case op_aload:
+        case op_astore:
+            out << fmt::sprintf("%s %d\n", mnemonic(ins.op), ins.arg);
+            break;
+        case op_iinc:
+            out << fmt::sprintf("iinc %d %d\n", ins.arg, ins.arg2);
+            break;
+        case op_ifeq:
+        case op_ifne:
+        case op_if_icmpeq:
+        case op_if_icmpne:
+        case op_if_icmplt:
+        case op_if_icmple:
+        case op_if_icmpgt:
+        case op_if_icmpge:
+        case op_goto:
+            out << fmt::sprintf("%s L%d\n", mnemonic(ins.op), ins.arg);
+            break;
+        case op_getstatic:
+        case op_putstatic:
+            out << fmt::sprintf("%s %s/%s %s\n", mnemonic(ins.op), ins.owner, ins.name, ins.desc);
+            break;
+        case op_invokestatic:
+        case op_invokevirtual:
+        case op_invokespecial:
+            out << fmt::sprintf("%s %s/%s%s\n", mnemonic(ins.op), ins.owner, ins.name, ins.desc);
+            break;
+        case op_new:
+            out << fmt::sprintf("new %s\n", ins.owner);
+            break;
+        default:
+            out << fmt::sprintf("%s\n", mnemonic(ins.op));
+            break;
+        }
+    }
+}
+
+} // jvm
+} // ptb
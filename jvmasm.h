@@ -0,0 +1,133 @@
+// -----------------------------------------------------------------------------
+// Pararatibum - A linguagem do momento
+// -----------------------------------------------------------------------------
+
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace ptb { namespace jvm {
+
+struct jvmasm_error : public std::runtime_error {
+    jvmasm_error(const std::string& w) : std::runtime_error(w) {
+    }
+};
+
+// Instruções da JVM usadas pelo gerador de código
+enum opcode : uint8_t {
+    op_label,           // pseudo-instrução: define o rótulo arg
+
+    op_iconst,          // empilha o inteiro arg
+    op_ldc_string,      // empilha o literal name (com as aspas)
+    op_iload,           // arg: variável local
+    op_istore,
+    op_aload,
+    op_astore,
+    op_iinc,            // local arg += arg2
+
+    op_iadd,
+    op_isub,
+    op_imul,
+    op_idiv,
+    op_irem,
+    op_iand,
+    op_ior,
+
+    // desvios para o rótulo arg
+    op_ifeq,
+    op_ifne,
+    op_if_icmpeq,
+    op_if_icmpne,
+    op_if_icmplt,
+    op_if_icmple,
+    op_if_icmpgt,
+    op_if_icmpge,
+    op_goto,
+
+    // owner/name desc
+    op_getstatic,
+    op_putstatic,
+    op_invokestatic,
+    op_invokevirtual,
+    op_invokespecial,
+    op_new,             // owner: classe
+
+    op_dup,
+    op_pop,
+    op_ireturn,
+    op_areturn,
+    op_return,
+};
+
+struct insn {
+    opcode op;
+    int32_t arg;
+    int32_t arg2;
+    // campo ou método referenciado; em ldc_string, name é o literal
+    std::string owner;
+    std::string name;
+    std::string desc;
+
+    explicit insn(opcode op_, int32_t arg_ = 0, int32_t arg2_ = 0) :
+        op(op_), arg(arg_), arg2(arg2_) {
+    }
+
+    bool is_branch() const { return op >= op_ifeq && op <= op_goto; }
+    // a execução não segue para a próxima instrução
+    bool ends_flow() const {
+        return op == op_goto || op == op_ireturn || op == op_areturn ||
+               op == op_return;
+    }
+};
+
+const char *mnemonic(opcode op);
+// desvio condicional com a condição contrária (ifeq <-> ifne, lt <-> ge...)
+opcode negated(opcode op);
+
+// Código de um método, montado em memória antes de ser gravado, para que
+// possa ser analisado e transformado
+class method_code
+{
+public:
+    method_code() : m_next_label(0) {}
+
+    // começa um novo método; os rótulos abaixo de first_label ficam
+    // reservados para quem gera o código
+    void clear(int first_label);
+    int new_label() { return m_next_label++; }
+
+    void emit(opcode op, int32_t arg = 0, int32_t arg2 = 0) {
+        m_code.emplace_back(op, arg, arg2);
+    }
+    void emit_ref(opcode op, const std::string &owner, const std::string &name,
+                  const std::string &desc);
+    void emit_string(const std::string &literal);
+    void bind(int label) { emit(op_label, label); }
+
+    std::vector<insn>& code() { return m_code; }
+    const std::vector<insn>& code() const { return m_code; }
+
+    // maior profundidade da pilha de operandos, simulando o efeito de
+    // cada instrução em todos os caminhos a partir da entrada
+    int max_stack() const;
+
+    void write_jasmin(std::ostream &out) const;
+
+private:
+    std::vector<insn> m_code;
+    int m_next_label;
+};
+
+// Quantos valores a instrução desempilha e empilha
+void stack_effect(const insn &ins, int &pops, int &pushes);
+
+// Quantidade de valores nos argumentos do descritor de um método e se ele
+// devolve algum valor
+void describe_method(const std::string &desc, int &args, bool &returns);
+
+} // jvm
+} // ptb
@@ -4,458 +4,516 @@
 
 // Aqui é onde os paranauês acontecem...
 
-#include <sstream>
 #include "cppfmt/format.h"
+#include "cfg.h"
+#include "classfile.h"
+#include "dataflow.h"
 #include "jvmcodegen.h"
-#include "ast.h"
+#include "timing.h"
 #include "types.h"
-#include "tokens.h"
 
 namespace ptb {
 
-jvmcodegen::jvmcodegen()
+// Desvio da JVM que é tomado quando a comparação da IR é verdadeira
+static jvm::opcode compare_branch(ir::opcode op)
 {
+    switch (op) {
+    case ir::op_eq: return jvm::op_if_icmpeq;
+    case ir::op_ne: return jvm::op_if_icmpne;
+    case ir::op_lt: return jvm::op_if_icmplt;
+    case ir::op_le: return jvm::op_if_icmple;
+    case ir::op_gt: return jvm::op_if_icmpgt;
+    default: return jvm::op_if_icmpge;
+    }
 }
 
-void jvmcodegen::run(const ast::node_ptr &program, symbol_table_ptr& symtable)
+jvmcodegen::jvmcodegen(output mode) :
+    m_mode(mode), m_class(nullptr), m_module(nullptr), m_function(nullptr),
+    m_peephole(jvm::peephole::no_rules), m_local_counter(0)
 {
-    m_out.open("ptb.j");
-    if (!m_out.is_open()) {
-        throw jvmcodegen_error("Nao foi possivel abrir o arquivo ptb.j para escrita");
-    }
-    m_symtable = symtable;
-    // empilha o escopo global
-    m_stack.push(m_symtable->get_scope(0));
-    reset_locals();
-
-    gen_node(program);
-
-    m_out.close();
 }
 
-void jvmcodegen::gen_node(const ast::node_ptr &node) {
-
-    switch (node->type) {
-//    case ast::no_node: gen_node(node); break;
-    case ast::integer_node: gen_integer(node); break;
-    case ast::string_node: gen_string(node); break;
-    case ast::if_stmt_node: gen_if_stmt(node); break;
-    case ast::while_stmt_node: gen_while_stmt(node); break;
-    case ast::return_stmt_node: gen_return_stmt(node); break;
-    case ast::variable_node: gen_variable(node); break;
-    case ast::assign_stmt_node: gen_assign_stmt(node); break;
-    case ast::call_node: gen_call(node); break;
-    case ast::op_arithm_node: gen_op_arithm(node); break;
-    case ast::op_logical_node: gen_op_logical(node); break;
-    case ast::program_node: gen_program(node); break;
-    case ast::type_node: gen_type(node); break;
-    case ast::argument_node: gen_argument(node); break;
-    case ast::variable_decl_node: gen_variable_decl(node); break;
-    case ast::function_decl_node: gen_function_decl(node); break;
-    case ast::read_stmt_node: gen_read_stmt(node); break;
-    case ast::write_stmt_node: gen_write_stmt(node); break;
-    }
-}
-void jvmcodegen::gen_program(const ast::node_ptr &node)
+void jvmcodegen::run(const ir::module &m)
 {
-    m_out << fmt::sprintf(".class public ptb\n");
-    m_out << fmt::sprintf(".super java/lang/Object\n");
-
-    m_out << fmt::sprintf("; construtor padrao\n");
-    m_out << fmt::sprintf(".method public <init>()V\n");
-    m_out << fmt::sprintf("aload_0 ; empilha o this\n");
-    m_out << fmt::sprintf("invokespecial java/lang/Object/<init>()V ; super()\n");
-    m_out << fmt::sprintf("return\n");
-    m_out << fmt::sprintf(".end method\n\n");
+    m_module = &m;
+    jvm::class_writer writer("ptb", "java/lang/Object");
+    if (m_mode == classfile) {
+        m_class = &writer;
+    } else {
+        m_out.open("ptb.j");
+        if (!m_out.is_open()) {
+            throw jvmcodegen_error("Nao foi possivel abrir o arquivo ptb.j para escrita");
+        }
+        m_out << fmt::sprintf(".class public ptb\n");
+        m_out << fmt::sprintf(".super java/lang/Object\n");
+    }
+    for (const auto& g : m.globals) {
+        if (m_class) {
+            m_class->add_field(jvm::acc_public | jvm::acc_static, name_of(g.name), jvm_type(g.type));
+        } else {
+            m_out << fmt::sprintf(".field public static %s %s\n", name_of(g.name), jvm_type(g.type));
+        }
+    }
 
-    auto program = ast::to_program(node);
-    for (size_t i = 0; i < program->declarations.size(); i++) {
-        gen_node(program->declarations[i]);
+    if (!m_class) {
+        m_out << fmt::sprintf("; construtor padrao\n");
+    }
+    m_code.clear(0);
+    m_code.emit(jvm::op_aload, 0);
+    m_code.emit_ref(jvm::op_invokespecial, "java/lang/Object", "<init>", "()V");
+    m_code.emit(jvm::op_return);
+    write_method(jvm::acc_public, "<init>", "()V", 1);
+
+    // as globais são inicializadas quando a classe é carregada
+    if (!m.globals.empty()) {
+        gen_function(m.init);
+    }
+    for (const auto& func : m.functions) {
+        if (!func.blocks.empty()) {
+            gen_function(func);
+        }
     }
-}
 
-void jvmcodegen::gen_integer(const ast::node_ptr &node)
-{
-    auto num = ast::to_integer(node);
-    if (num->value >= 0 && num->value <= 5) {
-        m_out << fmt::sprintf("iconst_%d\n", num->value);
-    } else if (num->value == -1) {
-        m_out << fmt::sprintf("iconst_m1\n");
+    if (m_class) {
+        std::ofstream out("ptb.class", std::ios::binary);
+        if (!out.is_open()) {
+            throw jvmcodegen_error("Nao foi possivel abrir o arquivo ptb.class para escrita");
+        }
+        m_class->write(out);
+        m_class = nullptr;
     } else {
-        m_out << fmt::sprintf("ldc %d\n", num->value);
+        m_out.close();
     }
+    m_module = nullptr;
 }
 
-void jvmcodegen::gen_string(const ast::node_ptr &node)
-{
-    auto str = ast::to_lstring(node);
-    m_out << fmt::sprintf("ldc %s\n", str->value);
-}
-
-void jvmcodegen::gen_if_stmt(const ast::node_ptr &node)
+void jvmcodegen::gen_function(const ir::function &func)
 {
-    auto ifstmt = ast::to_if_stmt(node);
-
-    int else_label = get_next_label();
-    int end_label = get_next_label();
-
-    gen_node(ifstmt->eval_expr);
-    m_out << fmt::sprintf("ifeq L%d\n", else_label);
-
-    m_stack.push(m_symtable->get_scope(ifstmt->true_scope_id));
-    for (const auto& stmt : ifstmt->true_statements) {
-        gen_node(stmt);
+    m_function = &func;
+    m_forest.build(func);
+    assign_locals(func);
+    // os primeiros rótulos são os dos blocos
+    m_code.clear(static_cast<int>(func.blocks.size()));
+
+    // apenas os blocos que são destino de um desvio precisam de rótulo
+    std::vector<uint8_t> labeled(func.blocks.size(), 0);
+    for (size_t b = 0; b < func.blocks.size(); b++) {
+        const auto& term = func.blocks[b].terminator();
+        int next = static_cast<int>(b + 1);
+        if (term.op == ir::op_jump && term.target != next) {
+            labeled[term.target] = 1;
+        } else if (term.op == ir::op_branch) {
+            labeled[term.target == next ? term.alt : term.target] = 1;
+            if (term.target != next && term.alt != next) {
+                labeled[term.alt] = 1;
+            }
+        }
     }
-    m_out << fmt::sprintf("goto L%d\n", end_label);
-    m_out << fmt::sprintf("L%d:\n", else_label);
-    m_stack.pop();
 
-    m_stack.push(m_symtable->get_scope(ifstmt->false_scope_id));
-    for (const auto& stmt : ifstmt->false_statements) {
-        gen_node(stmt);
+    for (size_t b = 0; b < func.blocks.size(); b++) {
+        if (labeled[b]) {
+            m_code.bind(static_cast<int>(b));
+        }
+        const auto& code = func.blocks[b].code;
+        for (size_t i = 0; i < code.size(); i++) {
+            if (!m_forest.is_inlined(b, i)) {
+                gen_instr(code[i], b);
+            }
+        }
     }
-    m_stack.pop();
 
-    m_out << fmt::sprintf("L%d:\n", end_label);
+    bool init = &func == &m_module->init;
+    uint16_t access = init ? jvm::acc_static : jvm::acc_public | jvm::acc_static;
+    write_method(access, method_name(func), descriptor(func), m_local_counter);
+    m_function = nullptr;
 }
 
-void jvmcodegen::gen_while_stmt(const ast::node_ptr &node)
+// Grava o método montado em m_code, como texto para o Jasmin ou direto no
+// arquivo .class. A pilha reservada é exatamente a maior profundidade
+// alcançada pelo código.
+void jvmcodegen::write_method(uint16_t access, const std::string &name,
+                              const std::string &desc, int locals)
 {
-    auto whilestmt = ast::to_while_stmt(node);
-    m_stack.push(m_symtable->get_scope(whilestmt->scope_id));
-
-    int cond_label = get_next_label();
-    int end_label = get_next_label();
-
-    m_out << fmt::sprintf("L%d:\n", cond_label);
-    gen_node(whilestmt->eval_expr);
-    m_out << fmt::sprintf("ifeq L%d\n", end_label);
-
-    for (const auto& stmt : whilestmt->statements) {
-        gen_node(stmt);
+    if (m_peephole.rules() != jvm::peephole::no_rules) {
+        ir::scoped_timer timer("peephole");
+        m_peephole.run(m_code);
     }
-    m_out << fmt::sprintf("goto L%d\n", cond_label);
-    m_out << fmt::sprintf("L%d:\n", end_label);
-    m_stack.pop();
-}
-
-void jvmcodegen::gen_return_stmt(const ast::node_ptr &node)
-{
-    auto ret = ast::to_return_stmt(node);
-    gen_node(ret->expr);
-    int type = compute_type(ret->expr);
-    if (type == types::integer) {
-        m_out << fmt::sprintf("ireturn\n");
-    } else if (type == types::voidt) {
-        m_out << fmt::sprintf("return\n");
-    } else if (type == types::string) {
-        m_out << fmt::sprintf("areturn\n");
+    if (m_class) {
+        m_class->add_method(access, name, desc, locals, m_code);
+        return;
     }
+    m_out << fmt::sprintf(".method %s%s%s%s\n", access & jvm::acc_public ? "public " : "",
+                          access & jvm::acc_static ? "static " : "", name, desc);
+    m_out << fmt::sprintf(".limit locals %d\n", locals);
+    m_out << fmt::sprintf(".limit stack %d\n", m_code.max_stack());
+    m_code.write_jasmin(m_out);
+    m_out << fmt::sprintf(".end method\n\n");
 }
 
-void jvmcodegen::gen_variable(const ast::node_ptr &node)
+// Cada registrador guardado recebe uma variável local. Dois registradores
+// podem dividir a mesma variável quando nunca estão vivos ao mesmo tempo e
+// têm o mesmo tipo; a alocação é gulosa, na ordem em que os registradores
+// aparecem no código, sempre na menor variável livre. Os parâmetros ocupam
+// as primeiras variáveis e a função principal recebe os argumentos da
+// linha de comando na variável 0.
+void jvmcodegen::assign_locals(const ir::function &func)
 {
-    auto var = ast::to_variable(node);
-    auto sym = m_stack.top()->get(var->name);
-
-    if (sym.c_type() == types::integer) {
-        m_out << fmt::sprintf("iload %d\n", sym.local);
-    } else if (sym.c_type() == types::string) {
-        m_out << fmt::sprintf("aload %d\n", sym.local);
+    size_t count = func.regs.size();
+    std::vector<uint8_t> stored(count, 0);
+    std::vector<ir::vreg> order;
+    auto appears = [&](ir::vreg r) {
+        if (!stored[r] && !m_forest.is_inlined_reg(r)) {
+            stored[r] = 1;
+            order.push_back(r);
+        }
+    };
+    for (size_t r = 0; r < func.param_count; r++) {
+        appears(static_cast<ir::vreg>(r));
+    }
+    for (const auto& blk : func.blocks) {
+        for (const auto& ins : blk.code) {
+            if (ins.dst != ir::no_reg) {
+                appears(ins.dst);
+            }
+            ir::for_each_operand(ins, appears);
+        }
     }
-    // TODO: string, booleans, etc...
-}
 
-void jvmcodegen::gen_assign_stmt(const ast::node_ptr &node)
-{
-    auto assign = ast::to_assign_stmt(node);
-    auto identifier = ast::to_variable(assign->lvalue);
+    // interferência: o registrador escrito por uma instrução não pode
+    // dividir a variável com os que continuam vivos depois dela, fora a
+    // origem de uma cópia, que tem o mesmo valor
+    ir::cfg graph;
+    graph.build(func);
+    ir::liveness live;
+    live.compute(func, graph);
+    std::vector<ir::bitvector> interferes(count);
+    for (auto r : order) {
+        interferes[r].resize(count);
+    }
+    auto add_edge = [&](ir::vreg a, ir::vreg b) {
+        if (a != b && stored[a] && stored[b]) {
+            interferes[a].set(b);
+            interferes[b].set(a);
+        }
+    };
+    for (size_t b = 0; b < func.blocks.size(); b++) {
+        live.backward(func, static_cast<int32_t>(b), [&](size_t i, const ir::bitvector &after) {
+            const auto& ins = func.blocks[b].code[i];
+            if (ins.dst == ir::no_reg || !stored[ins.dst]) {
+                return;
+            }
+            after.for_each([&](size_t r) {
+                if (ins.op != ir::op_copy || static_cast<ir::vreg>(r) != ins.a) {
+                    add_edge(ins.dst, static_cast<ir::vreg>(r));
+                }
+            });
+        });
+    }
+    // os parâmetros são escritos juntos, antes da entrada
+    if (!func.blocks.empty()) {
+        for (size_t p = 0; p < func.param_count; p++) {
+            for (size_t q = p + 1; q < func.param_count; q++) {
+                add_edge(static_cast<ir::vreg>(p), static_cast<ir::vreg>(q));
+            }
+            live.live_in(0).for_each([&](size_t r) {
+                add_edge(static_cast<ir::vreg>(p), static_cast<ir::vreg>(r));
+            });
+        }
+    }
 
-    auto sym = m_stack.top()->get(identifier->name);
-    // escopo global?
-    if (m_stack.top()->id <= 0) {
-    } else {
-        gen_node(assign->rvalue);
-        switch (sym.c_type()) {
-            case types::integer:
-                m_out << fmt::sprintf("istore %d\n", sym.local);
-                break;
-            case types::string:
-                m_out << fmt::sprintf("astore %d\n", sym.local);
-                break;
-            default:
-                throw jvmcodegen_error(
-                    fmt::sprintf("Tipo de dado nao suportado para atribuicao %d",
-                        sym.c_type()));
+    m_slots.assign(count, -1);
+    std::vector<int> slot_types;
+    m_local_counter = func.is_main ? 1 : 0;
+    if (func.is_main) {
+        slot_types.push_back(types::voidt);
+    }
+    std::vector<uint8_t> taken;
+    for (auto r : order) {
+        int type = func.regs[r].type;
+        if (static_cast<size_t>(r) < func.param_count) {
+            m_slots[r] = get_next_local();
+            slot_types.push_back(type);
+            continue;
+        }
+        taken.assign(slot_types.size(), 0);
+        interferes[r].for_each([&](size_t other) {
+            if (m_slots[other] >= 0) {
+                taken[m_slots[other]] = 1;
+            }
+        });
+        int slot = 0;
+        while (slot < m_local_counter && (taken[slot] || slot_types[slot] != type)) {
+            slot++;
+        }
+        if (slot == m_local_counter) {
+            slot = get_next_local();
+            slot_types.push_back(type);
         }
+        m_slots[r] = slot;
     }
 }
 
-void jvmcodegen::gen_call(const ast::node_ptr &node)
+void jvmcodegen::gen_instr(const ir::instr &ins, int block)
 {
-    auto call = ast::to_call(node);
-    auto sym = m_stack.top()->get(call->name);
-
-    if (!call->param_list.empty()) {
-        size_t i = call->param_list.size() - 1;
-        while (true) {
-            gen_node(call->param_list[i]);
-            if (i == 0)
-                break;
-            i--;
+    int next = block + 1;
+    switch (ins.op) {
+    case ir::op_read:
+        m_code.emit_ref(jvm::op_new, "java/util/Scanner", "", "");
+        m_code.emit(jvm::op_dup);
+        m_code.emit_ref(jvm::op_getstatic, "java/lang/System", "in", "Ljava/io/InputStream;");
+        m_code.emit_ref(jvm::op_invokespecial, "java/util/Scanner", "<init>",
+                        "(Ljava/io/InputStream;)V");
+        if (ins.type == types::string) {
+            m_code.emit_ref(jvm::op_invokevirtual, "java/util/Scanner", "nextLine",
+                            "()Ljava/lang/String;");
+        } else {
+            m_code.emit_ref(jvm::op_invokevirtual, "java/util/Scanner", "nextInt", "()I");
+        }
+        gen_store(ins.dst);
+        break;
+    case ir::op_write:
+        m_code.emit_ref(jvm::op_getstatic, "java/lang/System", "out", "Ljava/io/PrintStream;");
+        gen_operand(ins.a);
+        if (ins.type == types::string) {
+            m_code.emit_ref(jvm::op_invokevirtual, "java/io/PrintStream", "print",
+                            "(Ljava/lang/String;)V");
+        } else {
+            m_code.emit_ref(jvm::op_invokevirtual, "java/io/PrintStream", "print", "(I)V");
         }
+        break;
+    case ir::op_store: {
+        const auto& g = m_module->globals[ins.imm];
+        gen_operand(ins.a);
+        m_code.emit_ref(jvm::op_putstatic, "ptb", name_of(g.name), jvm_type(g.type));
+        break;
     }
-    m_out << fmt::sprintf("invokestatic ptb/%s\n", sym.signature);
-    if (call->is_stmt) {
-        // se a função retornar alguma coisa, descarta o resultado
-        if (sym.c_type() != types::voidt) {
-            m_out << fmt::sprintf("pop\n");
+    case ir::op_jump:
+        if (ins.target != next) {
+            m_code.emit(jvm::op_goto, ins.target);
+        }
+        break;
+    case ir::op_branch:
+        if (ins.target == next) {
+            gen_jump_if(ins.a, false, ins.alt);
+        } else {
+            gen_jump_if(ins.a, true, ins.target);
+            if (ins.alt != next) {
+                m_code.emit(jvm::op_goto, ins.alt);
+            }
         }
+        break;
+    case ir::op_ret:
+        if (ins.a == ir::no_reg) {
+            m_code.emit(jvm::op_return);
+        } else {
+            gen_operand(ins.a);
+            m_code.emit(ins.type == types::string ? jvm::op_areturn : jvm::op_ireturn);
+        }
+        break;
+    default:
+        gen_value(ins);
+        if (ins.dst != ir::no_reg) {
+            gen_store(ins.dst);
+        } else if (ins.type != types::voidt) {
+            // se a função retornar alguma coisa, descarta o resultado
+            m_code.emit(jvm::op_pop);
+        }
+        break;
     }
 }
 
-void jvmcodegen::gen_op_arithm(const ast::node_ptr &node)
+// Empilha o valor calculado pela instrução
+void jvmcodegen::gen_value(const ir::instr &ins)
 {
-    auto op = ast::to_op_arithm(node);
-    gen_node(op->left);
-    gen_node(op->right);
-    switch (op->op) {
-        case '+': m_out << fmt::sprintf("iadd\n"); break;
-        case '-': m_out << fmt::sprintf("isub\n"); break;
-        case '*': m_out << fmt::sprintf("imul\n"); break;
-        case '/': m_out << fmt::sprintf("idiv\n"); break;
-        case '%': m_out << fmt::sprintf("irem\n"); break;
-        default:
-            throw jvmcodegen_error(
-                fmt::sprintf("Operacao aritmetica invalida %c", op->op));
+    switch (ins.op) {
+    case ir::op_const:
+        m_code.emit(jvm::op_iconst, ins.imm);
+        break;
+    case ir::op_string:
+        m_code.emit_string(name_of(ins.imm));
+        break;
+    case ir::op_copy:
+        gen_operand(ins.a);
+        break;
+    case ir::op_load: {
+        const auto& g = m_module->globals[ins.imm];
+        m_code.emit_ref(jvm::op_getstatic, "ptb", name_of(g.name), jvm_type(g.type));
+        break;
+    }
+    case ir::op_call: {
+        for (auto arg : ins.args) {
+            gen_operand(arg);
+        }
+        const auto& callee = m_module->functions[ins.imm];
+        m_code.emit_ref(jvm::op_invokestatic, "ptb", method_name(callee), descriptor(callee));
+        break;
+    }
+    case ir::op_add: gen_binary(ins, jvm::op_iadd); break;
+    case ir::op_sub: gen_binary(ins, jvm::op_isub); break;
+    case ir::op_mul: gen_binary(ins, jvm::op_imul); break;
+    case ir::op_div: gen_binary(ins, jvm::op_idiv); break;
+    case ir::op_rem: gen_binary(ins, jvm::op_irem); break;
+    case ir::op_eq:
+    case ir::op_ne:
+    case ir::op_lt:
+    case ir::op_le:
+    case ir::op_gt:
+    case ir::op_ge:
+        gen_binary(ins, compare_branch(ins.op));
+        break;
+    case ir::op_and:
+        gen_boolean(ins.a);
+        gen_boolean(ins.b);
+        m_code.emit(jvm::op_iand);
+        break;
+    case ir::op_or:
+        gen_boolean(ins.a);
+        gen_boolean(ins.b);
+        m_code.emit(jvm::op_ior);
+        break;
+    default:
+        throw jvmcodegen_error(fmt::sprintf("Instrucao invalida %s", ir::opcode_name(ins.op)));
     }
 }
 
-void jvmcodegen::gen_op_logical(const ast::node_ptr &node)
+// Empilha os dois operandos e aplica a operação; as comparações deixam 0
+// ou 1 na pilha
+void jvmcodegen::gen_binary(const ir::instr &ins, jvm::opcode op)
 {
-    auto op = ast::to_op_logical(node);
-    gen_node(op->left);
-    gen_node(op->right);
-    int true_label = get_next_label();
-    int end_label = get_next_label();
-    switch (op->op) {
-        case tok::eq:
-            m_out << fmt::sprintf("if_icmpeq L%d\n", true_label);
-            break;
-        case tok::ne:
-            m_out << fmt::sprintf("if_icmpne L%d\n", true_label);
-            break;
-        case tok::ge:
-            m_out << fmt::sprintf("if_icmpge L%d\n", true_label);
-            break;
-        case tok::le:
-            m_out << fmt::sprintf("if_icmple L%d\n", true_label);
-            break;
-        case tok::gt:
-            m_out << fmt::sprintf("if_icmpgt L%d\n", true_label);
-            break;
-        case tok::lt:
-            m_out << fmt::sprintf("if_icmplt L%d\n", true_label);
-            break;
-        case tok::b_and:
-            m_out << fmt::sprintf("iand\n");
-            m_out << fmt::sprintf("ifeq L%d\n", true_label);
-            break;
-        case tok::b_or:
-            m_out << fmt::sprintf("ior\n");
-            m_out << fmt::sprintf("ifeq L%d\n", true_label);
-            break;
-        default:
-            throw jvmcodegen_error(fmt::sprintf("Operacao logica invalida %s", token_name[op->op]));
+    gen_operand(ins.a);
+    gen_operand(ins.b);
+    if (op >= jvm::op_if_icmpeq && op <= jvm::op_if_icmpge) {
+        gen_compare(op);
+    } else {
+        m_code.emit(op);
     }
-    m_out << fmt::sprintf("iconst_0\n");
-    m_out << fmt::sprintf("goto L%d\n", end_label);
-    m_out << fmt::sprintf("L%d:\n", true_label);
-    m_out << fmt::sprintf("iconst_1\n");
-    m_out << fmt::sprintf("L%d:\n", end_label);
 }
 
-void jvmcodegen::gen_type(const ast::node_ptr &node) {}
-
-void jvmcodegen::gen_argument(const ast::node_ptr &node)
+// Empilha um operando: carrega a variável local ou calcula a subexpressão
+void jvmcodegen::gen_operand(ir::vreg r)
 {
-    auto arg = ast::to_argument(node);
-    auto& sym = m_stack.top()->get(arg->name);
-    sym.local = get_next_local();
+    if (m_slots[r] < 0) {
+        gen_value(m_forest.definition(*m_function, r));
+    } else if (m_function->regs[r].type == types::string) {
+        m_code.emit(jvm::op_aload, m_slots[r]);
+    } else {
+        m_code.emit(jvm::op_iload, m_slots[r]);
+    }
 }
 
-void jvmcodegen::gen_variable_decl(const ast::node_ptr &node)
+// Empilha o operando convertido para 0 ou 1
+void jvmcodegen::gen_boolean(ir::vreg r)
 {
-    auto var = ast::to_variable_decl(node);
-    auto& sym = m_stack.top()->get(var->name);
-    // escopo global?
-    if (m_stack.top()->id <= 0) {
-    } else {
-        sym.local = get_next_local();
-        switch (sym.c_type()) {
-            case types::integer:
-                if (var->value->is_valid()) {
-                    gen_node(var->value);
-                } else {
-                    m_out << fmt::sprintf("iconst_0\n");
-                }
-                m_out << fmt::sprintf("istore %d\n", sym.local);
-                break;
-            case types::string:
-                if (var->value->is_valid()) {
-                    gen_node(var->value);
-                } else {
-                    m_out << fmt::sprintf("ldc ""\n");
-                }
-                m_out << fmt::sprintf("astore %d\n", sym.local);
-                break;
-            default:
-                throw jvmcodegen_error("Apenas inteiros sao suportados pelo gerador");
+    gen_operand(r);
+    if (m_slots[r] < 0) {
+        const auto& def = m_forest.definition(*m_function, r);
+        if ((def.op >= ir::op_eq && def.op <= ir::op_or) ||
+            (def.op == ir::op_const && (def.imm == 0 || def.imm == 1))) {
+            return;
         }
     }
+    int zero_label = m_code.new_label();
+    int end_label = m_code.new_label();
+    m_code.emit(jvm::op_ifeq, zero_label);
+    m_code.emit(jvm::op_iconst, 1);
+    m_code.emit(jvm::op_goto, end_label);
+    m_code.bind(zero_label);
+    m_code.emit(jvm::op_iconst, 0);
+    m_code.bind(end_label);
 }
 
-void jvmcodegen::gen_function_decl(const ast::node_ptr &node)
+// Transforma os dois inteiros no topo da pilha em 0 ou 1
+void jvmcodegen::gen_compare(jvm::opcode branch)
 {
-    auto func = ast::to_function_decl(node);
-    auto curr_scope = m_stack.top();
-    auto& sym = curr_scope->get(func->name);
-    if (!sym.is_valid()) {
-        throw jvmcodegen_error(fmt::sprintf("%s simbolo nao encontrado!", func->name));
-    }
-
-    // empilha o escopo da função
-    m_stack.push(m_symtable->get_scope(sym.scope_id));
-    reset_locals();
-    reset_labels();
+    int true_label = m_code.new_label();
+    int end_label = m_code.new_label();
+    m_code.emit(branch, true_label);
+    m_code.emit(jvm::op_iconst, 0);
+    m_code.emit(jvm::op_goto, end_label);
+    m_code.bind(true_label);
+    m_code.emit(jvm::op_iconst, 1);
+    m_code.bind(end_label);
+}
 
-    m_out << fmt::sprintf(".method public static ");
-    std::stringstream ss;
-    if (func->is_main()) {
-        m_out << fmt::sprintf("main([Ljava/lang/String;)V\n");
-    } else {
-        ss << fmt::sprintf("%s(", func->name);
-        for (size_t i = 0; i < func->arguments.size(); i++) {
-            auto arg = ast::to_argument(func->arguments[i]);
-            auto& asym = m_stack.top()->get(arg->name);
-            ss << fmt::sprintf("%s", jvm_type(asym.c_type()));
-            if (i != func->arguments.size() - 1)
-                ss << m_out << fmt::sprintf(",");
+// Desvia para label quando o valor de r, como booleano, for igual a when;
+// senão segue para a próxima instrução. As comparações viram um único
+// if_icmp e eu/tu viram desvios em sequência, sem calcular 0 ou 1.
+void jvmcodegen::gen_jump_if(ir::vreg r, bool when, int label)
+{
+    if (m_slots[r] < 0) {
+        const auto& def = m_forest.definition(*m_function, r);
+        switch (def.op) {
+        case ir::op_const:
+            if ((def.imm != 0) == when) {
+                m_code.emit(jvm::op_goto, label);
+            }
+            return;
+        case ir::op_eq:
+        case ir::op_ne:
+        case ir::op_lt:
+        case ir::op_le:
+        case ir::op_gt:
+        case ir::op_ge: {
+            gen_operand(def.a);
+            gen_operand(def.b);
+            jvm::opcode branch = compare_branch(def.op);
+            m_code.emit(when ? branch : jvm::negated(branch), label);
+            return;
         }
-        ss << fmt::sprintf(")%s", jvm_type(sym.type & ~types::function));
-
-        // salva a assinatura para realizar chamadas..
-        sym.signature = ss.str();
-        m_out << fmt::sprintf(ss.str());
-        m_out << fmt::sprintf("\n");
-    }
-
-    int locals = compute_locals(node);
-    if (func->is_main())
-        locals += 1;
-    m_out << fmt::sprintf(".limit locals %d\n", locals);
-    m_out << fmt::sprintf(".limit stack 15\n");
-
-    for (const auto& arg : func->arguments) {
-        gen_node(arg);
-    }
-    for (const auto& stmt : func->statements) {
-        gen_node(stmt);
-    }
-    m_stack.pop();
-
-    if (!func->is_main()) {
-        if (sym.c_type() == types::integer) {
-            m_out << fmt::sprintf("ireturn\n");
-        } else if (sym.c_type() == types::voidt) {
-            m_out << fmt::sprintf("return\n");
-        } else if (sym.c_type() == types::string) {
-            m_out << fmt::sprintf("areturn\n");
+        case ir::op_and:
+        case ir::op_or:
+            // o lado esquerdo já decide quando é falso num eu ou
+            // verdadeiro num tu
+            if (when == (def.op == ir::op_or)) {
+                gen_jump_if(def.a, when, label);
+                gen_jump_if(def.b, when, label);
+            } else {
+                int skip_label = m_code.new_label();
+                gen_jump_if(def.a, !when, skip_label);
+                gen_jump_if(def.b, when, label);
+                m_code.bind(skip_label);
+            }
+            return;
+        default:
+            break;
         }
-    } else {
-        m_out << fmt::sprintf("return\n");
     }
-    m_out << fmt::sprintf(".end method\n\n");
+    gen_operand(r);
+    m_code.emit(when ? jvm::op_ifne : jvm::op_ifeq, label);
 }
 
-void jvmcodegen::gen_read_stmt(const ast::node_ptr &node)
+void jvmcodegen::gen_store(ir::vreg r)
 {
-    auto read = ast::to_read_stmt(node);
-
-    auto& sym = m_stack.top()->get(read->identifier);
-    m_out << fmt::sprintf("new java/util/Scanner\n");
-    m_out << fmt::sprintf("dup\n");
-    m_out << fmt::sprintf("getstatic java/lang/System/in Ljava/io/InputStream;\n");
-    m_out << fmt::sprintf("invokespecial java/util/Scanner/<init>(Ljava/io/InputStream;)V\n");
-    if (sym.type == types::integer) {
-        m_out << fmt::sprintf("invokevirtual java/util/Scanner/nextInt()I\n");
-        m_out << fmt::sprintf("istore %d\n", sym.local);
-    } else if (sym.type == types::string) {
-        m_out << fmt::sprintf("invokevirtual java/util/Scanner/nextLine()Ljava/lang/String;\n");
-        m_out << fmt::sprintf("astore %d\n", sym.local);
+    if (m_function->regs[r].type == types::string) {
+        m_code.emit(jvm::op_astore, m_slots[r]);
+    } else {
+        m_code.emit(jvm::op_istore, m_slots[r]);
     }
 }
 
-void jvmcodegen::gen_write_stmt(const ast::node_ptr &node)
+// Nome do método na classe
+std::string jvmcodegen::method_name(const ir::function &func)
 {
-    auto write = ast::to_write_stmt(node);
-
-    m_out << fmt::sprintf("getstatic java/lang/System/out Ljava/io/PrintStream;\n");
-    int type = compute_type(write->expr);
-    gen_node(write->expr);
-    if (type == types::string) {
-        m_out << fmt::sprintf("invokevirtual java/io/PrintStream/print(Ljava/lang/String;)V\n");
-    } else if (type == types::integer) {
-        m_out << fmt::sprintf("invokevirtual java/io/PrintStream/print(I)V\n");
+    if (&func == &m_module->init) {
+        return "<clinit>";
     }
+    return func.is_main ? "main" : name_of(func.name);
 }
 
-int jvmcodegen::compute_locals(const ast::node_ptr &node)
+// Descritor do método: tipos dos parâmetros e do retorno
+std::string jvmcodegen::descriptor(const ir::function &func)
 {
-    switch (node->type) {
-    case ast::no_node: return 0;
-    case ast::integer_node: return 0;
-    case ast::string_node: return 0;
-    case ast::if_stmt_node: {
-        auto ifstmt = ast::to_if_stmt(node);
-        int count = 0;
-        for (const auto& stmt : ifstmt->true_statements) {
-            count += compute_locals(stmt);
-        }
-        for (const auto& stmt : ifstmt->false_statements) {
-            count += compute_locals(stmt);
-        }
-        return count;
+    if (&func == &m_module->init) {
+        return "()V";
     }
-    case ast::while_stmt_node: {
-        auto whilestmt = ast::to_while_stmt(node);
-        int count = 0;
-        for (const auto& stmt : whilestmt->statements) {
-            count += compute_locals(stmt);
-        }
-        return count;
-    }
-    case ast::return_stmt_node: return 0;
-    case ast::variable_node: return 0;
-    case ast::assign_stmt_node: return 0;
-    case ast::call_node: return 0;
-    case ast::op_arithm_node: return 0;
-    case ast::op_logical_node: return 0;
-    case ast::program_node: return 0;
-    case ast::type_node: return 0;
-    case ast::argument_node: return 1;
-    case ast::variable_decl_node: return 1;
-    case ast::function_decl_node: {
-        auto func = ast::to_function_decl(node);
-        int count = 0;
-        count += func->arguments.size();
-        for (const auto& stmt : func->statements) {
-            count += compute_locals(stmt);
-        }
-        return count;
+    if (func.is_main) {
+        return "([Ljava/lang/String;)V";
     }
+    std::string desc = "(";
+    for (size_t i = 0; i < func.param_count; i++) {
+        desc += jvm_type(func.regs[i].type);
     }
-    return 0;
+    return desc + fmt::sprintf(")%s", jvm_type(func.ret_type));
 }
 
 // Transforma um tipo nativo no tipo correspondente da JVM
@@ -472,49 +530,4 @@ std::string jvmcodegen::jvm_type(int type)
     return "V";
 }
 
-// Copiado do analisador semântico
-// TODO: refatorar...
-int jvmcodegen::compute_type(const ast::node_ptr &expr)
-{
-    switch (expr->type) {
-        case ast::call_node: {
-            auto curr_scope = m_stack.top();
-            auto sym = curr_scope->get(ast::to_call(expr)->name);
-            if (!sym.is_valid())
-                return -1;
-            return sym.type & ~types::function;
-        }
-        case ast::variable_node: {
-            auto curr_scope = m_stack.top();
-            auto sym = curr_scope->get(ast::to_variable(expr)->name);
-            if (!sym.is_valid())
-                return -1;
-            return sym.type;
-        }
-        case ast::integer_node:
-            return types::integer;
-        case ast::string_node:
-            return types::string;
-        case ast::type_node:
-            return ast::to_type(expr)->type_id;
-        case ast::op_logical_node: {
-            auto op = ast::to_op_logical(expr);
-            int lhs_type = compute_type(op->left);
-            int rhs_type = compute_type(op->right);
-            if (lhs_type == types::integer && rhs_type == types::integer)
-                return types::integer;
-            return -1;
-        }
-        case ast::op_arithm_node: {
-            auto op = ast::to_op_arithm(expr);
-            int lhs_type = compute_type(op->left);
-            int rhs_type = compute_type(op->right);
-            if (lhs_type == types::integer && rhs_type == types::integer)
-                return types::integer;
-            return -1;
-        }
-        default: return -1;
-    }
-}
-
 }
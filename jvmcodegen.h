@@ -5,10 +5,11 @@
 #pragma once
 #include <stdexcept>
 #include <string>
-#include <stack>
+#include <vector>
 #include <fstream>
-#include "ast.h"
-#include "symtable.h"
+#include "ir.h"
+#include "jvmasm.h"
+#include "jvmpeephole.h"
 
 namespace ptb {
 
@@ -17,47 +18,59 @@ struct jvmcodegen_error : public std::runtime_error {
     }
 };
 
+namespace jvm {
+class class_writer;
+}
+
 class jvmcodegen
 {
 public:
-    jvmcodegen();
+    // ptb.j em texto, para ser montado pelo Jasmin, ou o ptb.class pronto
+    enum output { jasmin, classfile };
+
+    jvmcodegen(output mode = jasmin);
 
-    void run(const ast::node_ptr &program, symbol_table_ptr &symtable);
+    // regras do peephole aplicadas ao código de cada método antes de ser
+    // gravado (jvm::peephole::rule)
+    void set_peephole(unsigned rules) { m_peephole = jvm::peephole(rules); }
+
+    void run(const ir::module &m);
 private:
-    symbol_table_ptr m_symtable;
     std::ofstream m_out;
 
-    void gen_node(const ast::node_ptr &node);
-    void gen_integer(const ast::node_ptr &node);
-    void gen_string(const ast::node_ptr &node);
-    void gen_if_stmt(const ast::node_ptr &node);
-    void gen_while_stmt(const ast::node_ptr &node);
-    void gen_return_stmt(const ast::node_ptr &node);
-    void gen_variable(const ast::node_ptr &node);
-    void gen_assign_stmt(const ast::node_ptr &node);
-    void gen_call(const ast::node_ptr &node);
-    void gen_op_arithm(const ast::node_ptr &node);
-    void gen_op_logical(const ast::node_ptr &node);
-    void gen_program(const ast::node_ptr &node);
-    void gen_type(const ast::node_ptr &node);
-    void gen_argument(const ast::node_ptr &node);
-    void gen_variable_decl(const ast::node_ptr &node);
-    void gen_function_decl(const ast::node_ptr &node);
-    void gen_read_stmt(const ast::node_ptr &node);
-    void gen_write_stmt(const ast::node_ptr &node);
-
-    int compute_type(const ast::node_ptr &expr);
-    int compute_locals(const ast::node_ptr &node);
+    void gen_function(const ir::function &func);
+    void gen_instr(const ir::instr &ins, int block);
+    void gen_value(const ir::instr &ins);
+    void gen_binary(const ir::instr &ins, jvm::opcode op);
+    void gen_operand(ir::vreg r);
+    void gen_boolean(ir::vreg r);
+    void gen_compare(jvm::opcode branch);
+    void gen_jump_if(ir::vreg r, bool when, int label);
+    void gen_store(ir::vreg r);
+    void write_method(uint16_t access, const std::string &name,
+                      const std::string &desc, int locals);
+
+    void assign_locals(const ir::function &func);
+    std::string method_name(const ir::function &func);
+    std::string descriptor(const ir::function &func);
     std::string jvm_type(int type);
 
-    std::stack<scope_ptr> m_stack;
+    output m_mode;
+    // arquivo .class sendo montado, apenas no modo classfile
+    jvm::class_writer *m_class;
+    const ir::module *m_module;
+    // função sendo gerada
+    const ir::function *m_function;
+    ir::expr_forest m_forest;
+    // código do método sendo gerado
+    jvm::method_code m_code;
+    jvm::peephole m_peephole;
+    // variável local da JVM de cada registrador, -1 se ele nunca é guardado
+    std::vector<int> m_slots;
+
     int m_local_counter;
-    int m_label_counter;
 
     int get_next_local() { return m_local_counter++; }
-    int get_next_label() { return m_label_counter++; }
-    void reset_locals() { m_local_counter = 0; }
-    void reset_labels() { m_label_counter = 0; }
 };
 
 }
@@ -0,0 +1,475 @@
+// -----------------------------------------------------------------------------
+// Pararatibum - A linguagem do momento
+// -----------------------------------------------------------------------------
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <utility>
+#include "jvmpeephole.h"
+
+namespace ptb { namespace jvm {
+
+// Posição de cada rótulo no código, -1 nos que não foram definidos
+static std::vector<int> label_positions(const std::vector<insn> &code)
+{
+    std::vector<int> labels;
+    for (size_t i = 0; i < code.size(); i++) {
+        if (code[i].op == op_label) {
+            auto label = static_cast<size_t>(code[i].arg);
+            if (label >= labels.size()) {
+                labels.resize(label + 1, -1);
+            }
+            labels[label] = static_cast<int>(i);
+        }
+    }
+    return labels;
+}
+
+static int position_of(const std::vector<int> &labels, int32_t label)
+{
+    auto l = static_cast<size_t>(label);
+    return l < labels.size() ? labels[l] : -1;
+}
+
+// Primeira instrução a partir de i que não é um rótulo
+static size_t skip_labels(const std::vector<insn> &code, size_t i)
+{
+    while (i < code.size() && code[i].op == op_label) {
+        i++;
+    }
+    return i;
+}
+
+// O rótulo está definido logo antes da instrução next, entre ela e a
+// instrução i
+static bool bound_before(const std::vector<int> &labels, int32_t label,
+                         size_t i, size_t next)
+{
+    int pos = position_of(labels, label);
+    return pos > static_cast<int>(i) && pos < static_cast<int>(next);
+}
+
+static bool is_return(opcode op)
+{
+    return op == op_ireturn || op == op_areturn || op == op_return;
+}
+
+static bool is_conditional(opcode op)
+{
+    return op >= op_ifeq && op <= op_if_icmpge;
+}
+
+static bool compare(opcode op, int32_t a, int32_t b)
+{
+    switch (op) {
+    case op_if_icmpeq: return a == b;
+    case op_if_icmpne: return a != b;
+    case op_if_icmplt: return a < b;
+    case op_if_icmple: return a <= b;
+    case op_if_icmpgt: return a > b;
+    default: return a >= b;
+    }
+}
+
+// Monta o código novo só a partir da primeira mudança: enquanto nenhuma
+// regra se aplica, as instruções ficam onde estão
+class rewriter
+{
+public:
+    explicit rewriter(std::vector<insn> &code) : m_code(code), m_changed(false) {}
+
+    // a instrução i continua no código
+    void keep(size_t i) {
+        if (m_changed) {
+            m_out.push_back(std::move(m_code[i]));
+        }
+    }
+    // as instruções a partir de i serão trocadas pelo que for emitido
+    void replace(size_t i) {
+        if (!m_changed) {
+            m_changed = true;
+            m_out.reserve(m_code.size());
+            m_out.insert(m_out.end(), std::make_move_iterator(m_code.begin()),
+                         std::make_move_iterator(m_code.begin() + i));
+        }
+    }
+    void emit(opcode op, int32_t arg = 0, int32_t arg2 = 0) {
+        m_out.emplace_back(op, arg, arg2);
+    }
+    void emit(insn &&ins) { m_out.push_back(std::move(ins)); }
+
+    bool finish() {
+        if (m_changed) {
+            m_code.swap(m_out);
+        }
+        return m_changed;
+    }
+
+private:
+    std::vector<insn> &m_code;
+    std::vector<insn> m_out;
+    bool m_changed;
+};
+
+bool peephole::run(method_code &code)
+{
+    auto& insns = code.code();
+    bool modified = false;
+    for (bool changed = m_rules != no_rules; changed;) {
+        changed = false;
+        if (m_rules & dead_code) {
+            changed |= remove_dead(insns);
+        }
+        if (m_rules & thread_jumps) {
+            changed |= thread(insns);
+        }
+        if (m_rules & fold_branches) {
+            changed |= fold(insns);
+        }
+        if (m_rules & form_iinc) {
+            changed |= make_iinc(insns);
+        }
+        if (m_rules & forward_stores) {
+            changed |= forward(insns);
+        }
+        modified |= changed;
+    }
+    return modified;
+}
+
+bool peephole::thread(std::vector<insn> &code)
+{
+    bool changed = false;
+    auto labels = label_positions(code);
+
+    // segue a cadeia de gotos a partir do rótulo; num ciclo o desvio fica
+    // como está
+    std::vector<int32_t> visited;
+    auto final_target = [&](int32_t label) {
+        visited.assign(1, label);
+        for (int32_t target = label;;) {
+            int pos = position_of(labels, target);
+            if (pos < 0) {
+                return label;
+            }
+            size_t j = skip_labels(code, static_cast<size_t>(pos));
+            if (j == code.size() || code[j].op != op_goto) {
+                return target;
+            }
+            target = code[j].arg;
+            if (std::find(visited.begin(), visited.end(), target) != visited.end()) {
+                return label;
+            }
+            visited.push_back(target);
+        }
+    };
+    for (auto& ins : code) {
+        if (!ins.is_branch()) {
+            continue;
+        }
+        int32_t target = final_target(ins.arg);
+        if (target != ins.arg) {
+            ins.arg = target;
+            changed = true;
+        }
+        // a pilha no goto é a mesma do return no destino
+        int pos = position_of(labels, ins.arg);
+        if (ins.op == op_goto && pos >= 0) {
+            size_t j = skip_labels(code, static_cast<size_t>(pos));
+            if (j < code.size() && is_return(code[j].op)) {
+                ins = insn(code[j].op);
+                changed = true;
+            }
+        }
+    }
+
+    rewriter out(code);
+    for (size_t i = 0; i < code.size(); i++) {
+        const auto& ins = code[i];
+        if (!ins.is_branch() || position_of(labels, ins.arg) < 0) {
+            out.keep(i);
+            continue;
+        }
+        size_t next = skip_labels(code, i + 1);
+        if (bound_before(labels, ins.arg, i, next)) {
+            // desvio para a instrução seguinte: só descarta os operandos
+            int pops, pushes;
+            stack_effect(ins, pops, pushes);
+            out.replace(i);
+            for (int p = 0; p < pops; p++) {
+                out.emit(op_pop);
+            }
+            continue;
+        }
+        // if L1; goto L2; L1: vira o if contrário direto para L2
+        if (is_conditional(ins.op) && next == i + 1 && next < code.size() &&
+            code[next].op == op_goto &&
+            bound_before(labels, ins.arg, next, skip_labels(code, next + 1))) {
+            out.replace(i);
+            out.emit(negated(ins.op), code[next].arg);
+            i = next;
+            continue;
+        }
+        out.keep(i);
+    }
+    return out.finish() || changed;
+}
+
+bool peephole::remove_dead(std::vector<insn> &code)
+{
+    auto labels = label_positions(code);
+    std::vector<uint8_t> reached(code.size(), 0);
+    std::vector<size_t> work;
+    auto reach = [&](size_t i) {
+        if (i < code.size() && !reached[i]) {
+            reached[i] = 1;
+            work.push_back(i);
+        }
+    };
+    std::vector<uint8_t> referenced(labels.size(), 0);
+    reach(0);
+    while (!work.empty()) {
+        size_t i = work.back();
+        work.pop_back();
+        const auto& ins = code[i];
+        int pos = ins.is_branch() ? position_of(labels, ins.arg) : -1;
+        if (pos >= 0) {
+            referenced[ins.arg] = 1;
+            reach(static_cast<size_t>(pos));
+        }
+        if (!ins.ends_flow()) {
+            reach(i + 1);
+        }
+    }
+
+    rewriter out(code);
+    for (size_t i = 0; i < code.size(); i++) {
+        if (reached[i] && (code[i].op != op_label || referenced[code[i].arg])) {
+            out.keep(i);
+        } else {
+            out.replace(i);
+        }
+    }
+    return out.finish();
+}
+
+bool peephole::fold(std::vector<insn> &code)
+{
+    rewriter out(code);
+    for (size_t i = 0; i < code.size(); i++) {
+        const auto& ins = code[i];
+        size_t left = code.size() - i;
+        bool taken = false;
+        size_t used = 0;
+        if (ins.op == op_iconst && left >= 2 &&
+            (code[i + 1].op == op_ifeq || code[i + 1].op == op_ifne)) {
+            taken = (ins.arg == 0) == (code[i + 1].op == op_ifeq);
+            used = 2;
+        } else if (ins.op == op_iconst && left >= 3 && code[i + 1].op == op_iconst &&
+                   code[i + 2].op >= op_if_icmpeq && code[i + 2].op <= op_if_icmpge) {
+            taken = compare(code[i + 2].op, ins.arg, code[i + 1].arg);
+            used = 3;
+        }
+        if (used == 0) {
+            out.keep(i);
+            continue;
+        }
+        out.replace(i);
+        if (taken) {
+            out.emit(op_goto, code[i + used - 1].arg);
+        }
+        i += used - 1;
+    }
+    return out.finish();
+}
+
+bool peephole::make_iinc(std::vector<insn> &code)
+{
+    rewriter out(code);
+    for (size_t i = 0; i < code.size(); i++) {
+        if (i + 3 < code.size() && code[i + 3].op == op_istore &&
+            (code[i + 2].op == op_iadd || code[i + 2].op == op_isub)) {
+            const auto& a = code[i];
+            const auto& b = code[i + 1];
+            int32_t slot = code[i + 3].arg;
+            // n + k, k + n ou n - k
+            const insn *k = nullptr;
+            if (a.op == op_iload && a.arg == slot && b.op == op_iconst) {
+                k = &b;
+            } else if (code[i + 2].op == op_iadd && a.op == op_iconst &&
+                       b.op == op_iload && b.arg == slot) {
+                k = &a;
+            }
+            int64_t delta = k ? k->arg : 0;
+            if (code[i + 2].op == op_isub) {
+                delta = -delta;
+            }
+            // o incremento cabe num byte, sem precisar do wide
+            if (k && delta >= -128 && delta <= 127) {
+                out.replace(i);
+                out.emit(op_iinc, slot, static_cast<int32_t>(delta));
+                i += 3;
+                continue;
+            }
+        }
+        out.keep(i);
+    }
+    return out.finish();
+}
+
+// Instruções que só empilham um valor, sem nenhum outro efeito
+static bool pushes_only(opcode op)
+{
+    return op == op_iconst || op == op_ldc_string || op == op_iload ||
+           op == op_aload || op == op_dup;
+}
+
+static bool is_load(opcode op) { return op == op_iload || op == op_aload; }
+static bool is_store(opcode op) { return op == op_istore || op == op_astore; }
+
+// a carga lê o que a escrita grava: mesma variável e mesmo tipo
+static bool same_local(const insn &store, const insn &load)
+{
+    return store.arg == load.arg &&
+           (store.op == op_istore) == (load.op == op_iload);
+}
+
+// Para cada instrução que usa uma variável local, se ela ainda é lida por
+// algum caminho depois da instrução. A análise é feita por blocos (entre
+// rótulos e desvios) até o ponto fixo, e depois instrução por instrução
+// dentro de cada bloco. Os métodos têm poucas variáveis, então os
+// conjuntos de todos os blocos ficam num único vetor de palavras.
+static std::vector<uint8_t> live_after(const std::vector<insn> &code)
+{
+    size_t slots = 0;
+    std::vector<size_t> starts;
+    for (size_t i = 0; i < code.size(); i++) {
+        const auto& ins = code[i];
+        if (is_load(ins.op) || is_store(ins.op) || ins.op == op_iinc) {
+            slots = std::max(slots, static_cast<size_t>(ins.arg) + 1);
+        }
+        if (i == 0 || ins.op == op_label || code[i - 1].is_branch() ||
+            code[i - 1].ends_flow()) {
+            starts.push_back(i);
+        }
+    }
+    size_t blocks = starts.size();
+    starts.push_back(code.size());
+    std::vector<uint32_t> block_of(code.size());
+    for (size_t b = 0; b < blocks; b++) {
+        for (size_t i = starts[b]; i < starts[b + 1]; i++) {
+            block_of[i] = static_cast<uint32_t>(b);
+        }
+    }
+    auto labels = label_positions(code);
+
+    // in = gen | (out - kill), com gen e kill calculados de trás para
+    // frente dentro do bloco
+    size_t words = (slots + 63) / 64;
+    std::vector<uint64_t> gen(blocks * words, 0), kill(blocks * words, 0);
+    std::vector<uint64_t> live_in(blocks * words, 0), live_out(blocks * words, 0);
+    auto word = [&](size_t b, size_t slot) { return b * words + slot / 64; };
+    auto bit = [](size_t slot) { return uint64_t(1) << (slot % 64); };
+    for (size_t b = 0; b < blocks; b++) {
+        for (size_t i = starts[b + 1]; i-- > starts[b];) {
+            const auto& ins = code[i];
+            if (is_store(ins.op)) {
+                gen[word(b, ins.arg)] &= ~bit(ins.arg);
+                kill[word(b, ins.arg)] |= bit(ins.arg);
+            } else if (is_load(ins.op) || ins.op == op_iinc) {
+                gen[word(b, ins.arg)] |= bit(ins.arg);
+            }
+        }
+    }
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (size_t b = blocks; b-- > 0;) {
+            const auto& last = code[starts[b + 1] - 1];
+            int pos = last.is_branch() ? position_of(labels, last.arg) : -1;
+            bool falls = !last.ends_flow() && b + 1 < blocks;
+            for (size_t w = 0; w < words; w++) {
+                uint64_t out = live_out[b * words + w];
+                if (falls) {
+                    out |= live_in[(b + 1) * words + w];
+                }
+                if (pos >= 0) {
+                    out |= live_in[block_of[pos] * words + w];
+                }
+                live_out[b * words + w] = out;
+                uint64_t in = gen[b * words + w] | (out & ~kill[b * words + w]);
+                if (in != live_in[b * words + w]) {
+                    live_in[b * words + w] = in;
+                    changed = true;
+                }
+            }
+        }
+    }
+
+    std::vector<uint8_t> result(code.size(), 0);
+    std::vector<uint64_t> live(words);
+    for (size_t b = 0; b < blocks; b++) {
+        std::copy(live_out.begin() + b * words, live_out.begin() + (b + 1) * words,
+                  live.begin());
+        for (size_t i = starts[b + 1]; i-- > starts[b];) {
+            const auto& ins = code[i];
+            if (is_store(ins.op)) {
+                result[i] = (live[word(0, ins.arg)] & bit(ins.arg)) != 0;
+                live[word(0, ins.arg)] &= ~bit(ins.arg);
+            } else if (is_load(ins.op) || ins.op == op_iinc) {
+                result[i] = (live[word(0, ins.arg)] & bit(ins.arg)) != 0;
+                live[word(0, ins.arg)] |= bit(ins.arg);
+            }
+        }
+    }
+    return result;
+}
+
+bool peephole::forward(std::vector<insn> &code)
+{
+    auto live = live_after(code);
+    rewriter out(code);
+    for (size_t i = 0; i < code.size(); i++) {
+        auto& ins = code[i];
+        bool has_next = i + 1 < code.size();
+        // iload n; istore n não muda nada
+        if (is_load(ins.op) && has_next && is_store(code[i + 1].op) &&
+            same_local(code[i + 1], ins)) {
+            out.replace(i);
+            i++;
+            continue;
+        }
+        if (is_store(ins.op) || ins.op == op_iinc) {
+            if (!live[i]) {
+                // ninguém lê o valor gravado
+                out.replace(i);
+                if (ins.op != op_iinc) {
+                    out.emit(op_pop);
+                }
+                continue;
+            }
+            if (ins.op != op_iinc && has_next && is_load(code[i + 1].op) &&
+                same_local(ins, code[i + 1])) {
+                // o valor continua na pilha; a escrita só fica se a
+                // variável for lida de novo
+                out.replace(i);
+                if (live[i + 1]) {
+                    out.emit(op_dup);
+                    out.emit(std::move(ins));
+                }
+                i++;
+                continue;
+            }
+        }
+        if (pushes_only(ins.op) && has_next && code[i + 1].op == op_pop) {
+            out.replace(i);
+            i++;
+            continue;
+        }
+        out.keep(i);
+    }
+    return out.finish();
+}
+
+} // jvm
+} // ptb
@@ -0,0 +1,57 @@
+// -----------------------------------------------------------------------------
+// Pararatibum - A linguagem do momento
+// -----------------------------------------------------------------------------
+
+#pragma once
+
+#include <vector>
+#include "jvmasm.h"
+
+namespace ptb { namespace jvm {
+
+// Otimização peephole sobre o código de um método montado em memória: cada
+// regra olha umas poucas instruções vizinhas (ou o destino de um desvio) e
+// troca a sequência por outra equivalente e menor. As regras habilitadas
+// são aplicadas em rodadas até o código parar de mudar.
+class peephole
+{
+public:
+    enum rule : unsigned {
+        // desvios para um goto vão direto ao destino final, goto para um
+        // return vira o próprio return, desvios para a instrução seguinte
+        // somem e um desvio condicional sobre um goto é invertido
+        thread_jumps = 1 << 0,
+        // remove as instruções que nenhum caminho alcança e os rótulos que
+        // não são destino de nenhum desvio
+        dead_code = 1 << 1,
+        // iconst k; ifeq/ifne e comparações entre duas constantes viram
+        // goto ou nada
+        fold_branches = 1 << 2,
+        // iload n; iconst k; iadd; istore n vira iinc n k
+        form_iinc = 1 << 3,
+        // istore n; iload n vira dup; istore n, e as escritas em variáveis
+        // que não são mais lidas somem, com o valor ficando na pilha
+        forward_stores = 1 << 4,
+
+        no_rules = 0,
+        all_rules = (1 << 5) - 1,
+    };
+
+    explicit peephole(unsigned rules = all_rules) : m_rules(rules) {}
+
+    unsigned rules() const { return m_rules; }
+    // devolve true se o código foi modificado
+    bool run(method_code &code);
+
+private:
+    bool thread(std::vector<insn> &code);
+    bool remove_dead(std::vector<insn> &code);
+    bool fold(std::vector<insn> &code);
+    bool make_iinc(std::vector<insn> &code);
+    bool forward(std::vector<insn> &code);
+
+    unsigned m_rules;
+};
+
+} // jvm
+} // ptb
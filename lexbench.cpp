@@ -0,0 +1,177 @@
+// -----------------------------------------------------------------------------
+// Pararatibum - A linguagem do momento
+// -----------------------------------------------------------------------------
+
+#include <chrono>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <cppfmt/format.h>
+#include "lexbench.h"
+#include "lexer.h"
+#include "tokens.h"
+
+namespace ptb {
+
+struct keyword {
+    const char *text;
+    int type;
+};
+
+// Vocabulário fixo da linguagem
+static const keyword vocabulary[] = {
+    { "(", tok::l_par }, { ")", tok::r_par },
+    { "[", tok::l_bracket }, { "]", tok::r_bracket },
+    { "{", tok::l_curlbracket }, { "}", tok::r_curlbracket },
+    { ",", tok::comma }, { ";", tok::semicolon }, { ".", tok::dot },
+    { ":", tok::colon }, { ":=", tok::assign },
+    { "+", tok::plus }, { "-", tok::minus }, { "*", tok::mul },
+    { "/", tok::div }, { "%", tok::mod },
+    { "=", tok::eq }, { "!", tok::neg }, { "!=", tok::ne },
+    { ">", tok::gt }, { ">=", tok::ge }, { "<", tok::lt }, { "<=", tok::le },
+    { "tu", tok::b_or }, { "eu", tok::b_and },
+    { "^ela", tok::char_ }, { "^essa", tok::bool_ },
+    { "^esqueca", tok::true_ }, { "^faz", tok::false_ },
+    { "^menino", tok::int_ }, { "^novinha", tok::string_ },
+    { "^deixa", tok::void_ }, { "^mexer_com", tok::read_ },
+    { "^mostrar", tok::write_ }, { "^pedindo_mais", tok::while_ },
+    { "^parara", tok::if_ }, { "^tibum", tok::else_ },
+    { "^senta", tok::return_ }, { "@agora_eu_vou", tok::main_ },
+    { "@novinha", tok::itos_ }, { "@menino", tok::stoi_ },
+};
+
+// Palavras que não são reservadas, algumas parecidas com as que são
+static const char *const identifiers[] = {
+    "i", "n", "x", "nome", "primo", "e_primo", "fatorial", "total",
+    "tudo", "eu_mesmo", "tu_", "^men", "^parar", "@novinhas", "<<", "::",
+};
+
+typedef std::chrono::steady_clock bench_clock;
+
+static double elapsed_ns(bench_clock::time_point start)
+{
+    std::chrono::duration<double, std::nano> d = bench_clock::now() - start;
+    return d.count();
+}
+
+// Programa sintético com todas as classes de token: palavras reservadas,
+// identificadores, números, strings e comentários de linha e de bloco
+static std::string synthetic_program(size_t size)
+{
+    std::string text;
+    text.reserve(size + 1024);
+    for (unsigned i = 0; text.size() < size; i++) {
+        text += fmt::sprintf(
+            "# funcao gerada %u\n"
+            "^menino f%u(^menino a, ^menino b)\n"
+            "{\n"
+            "    ^menino x := a * %u + b - (a / 3);\n"
+            "    ^novinha s := \"texto %u\";\n"
+            "    ## comentario\n"
+            "       de bloco ##\n"
+            "    ^pedindo_mais (x > 0 eu b != %u) {\n"
+            "        ^parara (x %% 2 = 0) {\n"
+            "            x := x - 1;\n"
+            "        } ^tibum {\n"
+            "            x := x / 2;\n"
+            "        }\n"
+            "    }\n"
+            "    ^mostrar(s);\n"
+            "    ^senta x;\n"
+            "}\n\n", i, i, i % 1000, i, i % 7);
+    }
+    return text;
+}
+
+void bench_lexer(std::ostream &out)
+{
+    const std::string text = synthetic_program(50 * 1024 * 1024);
+
+    double best_ns = 0;
+    size_t tokens = 0;
+    for (int round = 0; round < 5; round++) {
+        lexer lex;
+        lex.load_text(text);
+        size_t count = 0;
+        auto start = bench_clock::now();
+        while (lex.get_token() != tok::eof) {
+            lex.consume();
+            count++;
+        }
+        double ns = elapsed_ns(start);
+        if (round == 0 || ns < best_ns) {
+            best_ns = ns;
+        }
+        tokens = count;
+    }
+    out << fmt::sprintf("%.1f MB, %u tokens, melhor de 5 rodadas: %.3f s (%.1f Mtok/s)\n",
+                        text.size() / (1024.0 * 1024.0), tokens, best_ns / 1e9,
+                        tokens / (best_ns / 1e3));
+}
+
+void bench_keywords(std::ostream &out)
+{
+    // as palavras ficam num único buffer, como no analisador léxico
+    std::string text;
+    std::vector<std::pair<size_t, size_t>> words;
+    std::vector<int> expected;
+    for (const auto& k : vocabulary) {
+        words.emplace_back(text.size(), std::char_traits<char>::length(k.text));
+        expected.push_back(k.type);
+        text += k.text;
+    }
+    for (auto id : identifiers) {
+        words.emplace_back(text.size(), std::char_traits<char>::length(id));
+        expected.push_back(-1);
+        text += id;
+    }
+
+    std::unordered_map<std::string, int> table;
+    for (const auto& k : vocabulary) {
+        table[k.text] = k.type;
+    }
+
+    for (size_t w = 0; w < words.size(); w++) {
+        int type = lexer::keyword_type(text.data() + words[w].first, words[w].second);
+        if (type != expected[w]) {
+            throw std::runtime_error(fmt::sprintf("keyword_type(%s) devolveu %d, esperado %d",
+                                                  text.substr(words[w].first, words[w].second),
+                                                  type, expected[w]));
+        }
+    }
+
+    const size_t lookups = 10 * 1000 * 1000;
+    long checksum = 0;
+
+    auto start = bench_clock::now();
+    for (size_t i = 0; i < lookups; i++) {
+        const auto& w = words[i % words.size()];
+        checksum += lexer::keyword_type(text.data() + w.first, w.second);
+    }
+    double switch_ns = elapsed_ns(start);
+
+    // o analisador antigo copiava o token para uma std::string e fazia
+    // find() seguido de operator[]
+    start = bench_clock::now();
+    for (size_t i = 0; i < lookups; i++) {
+        const auto& w = words[i % words.size()];
+        std::string token(text.data() + w.first, w.second);
+        if (table.find(token) != table.end()) {
+            checksum -= table[token];
+        } else {
+            checksum -= -1;
+        }
+    }
+    double map_ns = elapsed_ns(start);
+
+    if (checksum != 0) {
+        throw std::runtime_error("keyword_type e a tabela discordam");
+    }
+    out << fmt::sprintf("%u palavras (%u reservadas), %u buscas\n",
+                        words.size(), sizeof(vocabulary) / sizeof(vocabulary[0]), lookups);
+    out << fmt::sprintf("keyword_type   %8.2f ns/busca\n", switch_ns / lookups);
+    out << fmt::sprintf("unordered_map  %8.2f ns/busca\n", map_ns / lookups);
+}
+
+}
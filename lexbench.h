@@ -0,0 +1,23 @@
+// -----------------------------------------------------------------------------
+// Pararatibum - A linguagem do momento
+// -----------------------------------------------------------------------------
+
+#pragma once
+
+#include <ostream>
+
+namespace ptb {
+
+// Mede o analisador léxico (opção -bench-lexer): gera um programa
+// sintético de 50 MB, lê todos os tokens dele com get_token()/consume() e
+// mostra a melhor de 5 rodadas em tokens por segundo
+void bench_lexer(std::ostream &out);
+
+// Microbenchmark do reconhecimento de palavras reservadas (opção
+// -bench-keywords): confere lexer::keyword_type contra o vocabulário e
+// compara o seu tempo com a busca numa std::unordered_map, como o analisador
+// léxico fazia antes, sobre uma mistura de palavras reservadas e
+// identificadores.
+void bench_keywords(std::ostream &out);
+
+}
@@ -5,133 +5,180 @@
 #include <iostream>
 #include <fstream>
 #include <stdexcept>
-#include <cctype>
 #include <cstring>
+#include <algorithm>
 #include <format.h>
 #include "lexer.h"
 #include "tokens.h"
+#include "charscan.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#define PTB_HAS_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 namespace ptb
 {
 
 
-// Exceção lançada quando o fim do buffer de caractéres é encontrado
-struct eof_except : public std::exception {};
+// Classes de caractéres usadas pelo analisador léxico. Cada caractér
+// pertence a uma única classe, então a classe também serve para decidir
+// qual tipo de token começa na posição atual.
+enum char_class_t : unsigned char {
+    cc_invalid = 0,
+    cc_eof = 1 << 0,        // '\0' sentinela
+    cc_space = 1 << 1,      // espaço em branco, como std::isspace no locale "C"
+    cc_digit = 1 << 2,
+    cc_alpha = 1 << 3,      // letras ASCII e '_'
+    cc_prefix = 1 << 4,     // ^ e @, iniciam as palavras reservadas
+    cc_quote = 1 << 5,      // "
+    cc_comment = 1 << 6,    // #
+    cc_delim = 1 << 7,      // delimitadores e operadores
+};
+
+static constexpr bool in_set(const char *set, int c)
+{
+    return *set != '\0' && (*set == c || in_set(set + 1, c));
+}
+
+static constexpr unsigned char classify(int c)
+{
+    return c == '\0' ? cc_eof :
+           (c == ' ' || (c >= '\t' && c <= '\r')) ? cc_space :
+           (c >= '0' && c <= '9') ? cc_digit :
+           ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_') ? cc_alpha :
+           (c == '^' || c == '@') ? cc_prefix :
+           c == '"' ? cc_quote :
+           c == '#' ? cc_comment :
+           in_set("[](){}+-*/<>=!&~%|.,;:?", c) ? cc_delim :
+           cc_invalid;
+}
+
+#define CC_4(i) classify(i), classify(i + 1), classify(i + 2), classify(i + 3)
+#define CC_16(i) CC_4(i), CC_4(i + 4), CC_4(i + 8), CC_4(i + 12)
+#define CC_64(i) CC_16(i), CC_16(i + 16), CC_16(i + 32), CC_16(i + 48)
 
+// Tabela com a classe de cada byte, calculada em tempo de compilação
+static constexpr unsigned char char_classes[256] = {
+    CC_64(0), CC_64(64), CC_64(128), CC_64(192)
+};
 
-// Retorna o caractér na posição atual do buffer
-char lexer::get_char()
+#undef CC_64
+#undef CC_16
+#undef CC_4
+
+static inline unsigned char char_class(char c)
 {
-    if (m_line >= m_lines.size())
-        throw eof_except();
+    return char_classes[static_cast<unsigned char>(c)];
+}
 
-    const std::string& line = m_lines[m_line];
-    if (m_position >= line.size())
-        return '\n';
 
-    return line.at(m_position);
+// O buffer de caractéres sempre termina com um '\0' sentinela, então o fim
+// do arquivo é só mais um caractér a ser testado no laço do analisador.
+// Na leitura de um stream, o sentinela marca o fim do bloco lido até agora:
+// ao encontrá-lo o próximo bloco é carregado e a análise continua.
+
+// Retorna o caractér na posição atual do buffer, '\0' no final
+char lexer::get_char()
+{
+    char c = m_data[m_position];
+    if (c == '\0' && m_position == m_size && refill())
+        c = m_data[m_position];
+    return c;
 }
 
 
-// Avança uma posição no buffer de caracteres
+// Avança uma posição no buffer de caracteres, sem passar do sentinela
 void lexer::next_char()
 {
-    if (m_line >= m_lines.size())
-        throw eof_except();
-
-    const std::string& line = m_lines[m_line];
-    if (m_position >= line.size()) {
-        m_line++;
-        m_position = 0;
-        return;
-    }
-    m_position++;
+    if (m_position < m_size)
+        m_position++;
 }
 
 
 // Volta uma posição no buffer de caracteres
 void lexer::back_char()
 {
-    if (m_position == 0) {
-        if (m_line == 0)
-            return;
-        m_line--;
-        const std::string& line = m_lines[m_line];
-        m_position = line.size() - 1;
-        return;
-    }
-    m_position--;
+    if (m_position > 0)
+        m_position--;
 }
 
 
 // Retorna qual será o próximo caractér no texto.
 char lexer::peek_next()
 {
-    auto line = m_line;
-    auto pos = m_position;
-
-    next_char();
-    char c;
-    try {
-        c = get_char();
-    } catch (eof_except& e) {
-        c = '\0';
-    }
-    m_line = line;
-    m_position = pos;
+    if (m_position >= m_size)
+        return '\0';
+    char c = m_data[m_position + 1];
+    if (c == '\0' && m_position + 1 == m_size && refill())
+        c = m_data[m_position + 1];
     return c;
 }
 
 
+// Avança até a primeira ocorrência de c (ou até o final do texto).
+// Com discard o texto pulado não é mais necessário (comentários) e pode ser
+// liberado quando o próximo bloco de um stream for lido.
+void lexer::skip_until(char c, bool discard)
+{
+    char curr;
+    do {
+        if (discard)
+            mark();
+        m_position = charscan::find_char(m_data + m_position, c) - m_data;
+        curr = get_char();
+    } while (curr != c && curr != '\0');
+}
+
+
 // Ignora espaço em branco (tabs, espaços e quebras de linhas) no buffer
 void lexer::ignore_spaces()
 {
-    char c;
-    while ((c = get_char()), std::isspace(c))
-        next_char();
+    // caso comum: nenhum ou um único espaço entre dois tokens
+    if (!is_class(cc_space))
+        return;
+    next_char();
+    if (!is_class(cc_space))
+        return;
+    do {
+        mark();
+        m_position = charscan::skip_spaces(m_data + m_position) - m_data;
+    } while (is_class(cc_space));
 }
 
 
 // Ignora comentários e espaços em branco
 // Os comentários de linha são iniciados por #
 // Os comentários de bloco são iniciados e terminados por ##
+// Um comentário de bloco não terminado vai até o final do arquivo.
 void lexer::ignore_comments()
 {
     ignore_spaces();
-    char c = peek_next();
-
-    if (is_char('#')) {
+    while (is_char('#')) {
+        char c = peek_next();
         // comentários de linha
         if (c != '#') {
-            while ((c = get_char()), c != '\n')
-                next_char();
+            skip_until('\n', true);
         }
         // comentários de bloco
         else {
             // avança as duas posições de ##
             next_char();
             next_char();
-            char next = peek_next();
-            while (!(is_char('#') && next == '#')) {
+            while ((skip_until('#', true), is_char('#')) && peek_next() != '#')
                 next_char();
-                next = peek_next();
-            }
             // avança as duas posições de ##
             next_char();
             next_char();
         }
-        ignore_comments();
+        ignore_spaces();
     }
 }
 
 
-// Verifica se o carácter na posição atual for um digito
-bool lexer::is_digit()
-{
-    return std::isdigit(get_char());
-}
-
-
 // Verifica se o caractér na posição atual do texto é c
 bool lexer::is_char(char c)
 {
@@ -139,291 +186,458 @@ bool lexer::is_char(char c)
 }
 
 
-// Verifica se o carácter na posição atual é um alphanumérico
-bool lexer::is_alnum()
+// Verifica se o caractér na posição atual pertence a alguma das classes
+// em mask
+bool lexer::is_class(unsigned char mask)
 {
-    char c = get_char();
-    return std::isalnum(c) || is_char('_');
+    return (char_class(get_char()) & mask) != 0;
 }
 
-
-// Verifica se o c é um delimitador
-bool lexer::is_delim(char c)
+// Compara a faixa [s, s + n) com a palavra str
+#define KEYWORD(str, type)                                          \
+    if (n == sizeof(str) - 1 && std::memcmp(s, str, n) == 0)        \
+        return type
+
+// Reconhece as palavras reservadas e operadores da linguagem.
+// O vocabulário é fixo, então a busca é um switch sobre o primeiro
+// (e para as palavras com ^ e @, o segundo) caractér, seguido de uma
+// comparação com as poucas palavras candidatas. Retorna -1 se a palavra
+// não for reservada.
+int lexer::keyword_type(const char *s, size_t n)
 {
-    return strchr("[](){}+-*/<>=!&~%^|.,;:?", c) != nullptr;
+    switch (s[0]) {
+    case '(': KEYWORD("(", tok::l_par); break;
+    case ')': KEYWORD(")", tok::r_par); break;
+    case '[': KEYWORD("[", tok::l_bracket); break;
+    case ']': KEYWORD("]", tok::r_bracket); break;
+    case '{': KEYWORD("{", tok::l_curlbracket); break;
+    case '}': KEYWORD("}", tok::r_curlbracket); break;
+    case ',': KEYWORD(",", tok::comma); break;
+    case ';': KEYWORD(";", tok::semicolon); break;
+    case '.': KEYWORD(".", tok::dot); break;
+    case '+': KEYWORD("+", tok::plus); break;
+    case '-': KEYWORD("-", tok::minus); break;
+    case '*': KEYWORD("*", tok::mul); break;
+    case '/': KEYWORD("/", tok::div); break;
+    case '%': KEYWORD("%", tok::mod); break;
+    case '=': KEYWORD("=", tok::eq); break;
+    case ':':
+        KEYWORD(":", tok::colon);
+        KEYWORD(":=", tok::assign);
+        break;
+    case '!':
+        KEYWORD("!", tok::neg);
+        KEYWORD("!=", tok::ne);
+        break;
+    case '>':
+        KEYWORD(">", tok::gt);
+        KEYWORD(">=", tok::ge);
+        break;
+    case '<':
+        KEYWORD("<", tok::lt);
+        KEYWORD("<=", tok::le);
+        break;
+    case 't': KEYWORD("tu", tok::b_or); break;
+    case 'e': KEYWORD("eu", tok::b_and); break;
+    case '^':
+        if (n < 2)
+            break;
+        switch (s[1]) {
+        case 'e':
+            KEYWORD("^ela", tok::char_);
+            KEYWORD("^essa", tok::bool_);
+            KEYWORD("^esqueca", tok::true_);
+            break;
+        case 'm':
+            KEYWORD("^menino", tok::int_);
+            KEYWORD("^mexer_com", tok::read_);
+            KEYWORD("^mostrar", tok::write_);
+            break;
+        case 'n': KEYWORD("^novinha", tok::string_); break;
+        case 'd': KEYWORD("^deixa", tok::void_); break;
+        case 'p':
+            KEYWORD("^pedindo_mais", tok::while_);
+            KEYWORD("^parara", tok::if_);
+            break;
+        case 't': KEYWORD("^tibum", tok::else_); break;
+        case 's': KEYWORD("^senta", tok::return_); break;
+        case 'f': KEYWORD("^faz", tok::false_); break;
+        }
+        break;
+    case '@':
+        if (n < 2)
+            break;
+        switch (s[1]) {
+        case 'a': KEYWORD("@agora_eu_vou", tok::main_); break;
+        case 'n': KEYWORD("@novinha", tok::itos_); break;
+        case 'm': KEYWORD("@menino", tok::stoi_); break;
+        }
+        break;
+    }
+    return -1;
 }
 
+#undef KEYWORD
 
-// Verifica se o caractér na posição atual é um delimitador
-bool lexer::is_delim()
-{
-    return is_delim(get_char());
-}
 
-// Verifica se a palavra armazenada em m_token é reservada,
+// Verifica se a palavra do token atual é reservada,
 // se for, seu tipo é setado.
 bool lexer::check_for_keyword()
 {
-    // verifica se é uma palavra reservada
-    if (m_keywords.find(m_token) != m_keywords.end()) {
-        set_type(m_keywords[m_token]);
+    int type = keyword_type(m_data + (m_tok_start - m_base), m_tok_len);
+    if (type >= 0) {
+        set_type(type);
         return true;
     }
     return false;
 }
 
-// Copia o token do buffer de caracteres para m_token
-// Passando a posição inicial do token, essa função irá copiar até a posição atual
+
+// Marca o token atual no buffer de caracteres, nada é copiado.
+// Passando a posição inicial do token, o token vai até a posição atual
 void lexer::copy_token(size_t start)
 {
-    auto size = m_position - start;
-    const std::string& line = m_lines[m_line];
-    m_token = line.substr(start, size);
-    m_tok_info.lineno = m_line;
-    m_tok_info.start = start;
-    m_tok_info.end = m_position;
+    m_tok_start = start;
+    m_tok_len = offset() - start;
 }
 
 
-lexer::lexer()
+// Converte um offset do texto em (linha, coluna), ambos iniciando em 0.
+// A tabela com o início das linhas do buffer atual é construída na primeira
+// chamada, as linhas de blocos já descartados estão contadas em m_base_line.
+std::pair<size_t, size_t> lexer::line_column(size_t offset)
 {
-    m_keywords["("] = tok::l_par;
-    m_keywords[")"] = tok::r_par;
-    m_keywords["["] = tok::l_bracket;
-    m_keywords["]"] = tok::r_bracket;
-    m_keywords["{"] = tok::l_curlbracket;
-    m_keywords["}"] = tok::r_curlbracket;
-    m_keywords[","] = tok::comma;
-    m_keywords[":"] = tok::colon;
-    m_keywords[";"] = tok::semicolon;
-    m_keywords["."] = tok::dot;
-    m_keywords["+"] = tok::plus;
-    m_keywords["-"] = tok::minus;
-    m_keywords["*"] = tok::mul;
-    m_keywords["/"] = tok::div;
-    m_keywords["%"] = tok::mod;
-    m_keywords[":="] = tok::assign;
-    m_keywords["!"] = tok::neg;
-    m_keywords["="] = tok::eq;
-    m_keywords["!="] = tok::ne;
-    m_keywords[">="] = tok::ge;
-    m_keywords["<="] = tok::le;
-    m_keywords[">"] = tok::gt;
-    m_keywords["<"] = tok::lt;
-    m_keywords["tu"] = tok::b_or;
-    m_keywords["eu"] = tok::b_and;
-
-    m_keywords["^ela"] = tok::char_;
-    m_keywords["^essa"] = tok::bool_;
-    m_keywords["^menino"] = tok::int_;
-    m_keywords["^novinha"] = tok::string_;
-    m_keywords["^deixa"] = tok::void_;
-    m_keywords["^pedindo_mais"] = tok::while_;
-    m_keywords["^parara"] = tok::if_;
-    m_keywords["^tibum"] = tok::else_;
-    m_keywords["^senta"] = tok::return_;
-    m_keywords["^esqueca"] = tok::true_;
-    m_keywords["^faz"] = tok::false_;
-    m_keywords["^mexer_com"] = tok::read_;
-    m_keywords["^mostrar"] = tok::write_;
-    m_keywords["@agora_eu_vou"] = tok::main_;
-    m_keywords["@novinha"] = tok::itos_;
-    m_keywords["@menino"] = tok::stoi_;
-
+    if (m_line_starts.empty()) {
+        m_line_starts.push_back(m_base_line_start);
+        for (size_t i = 0; i < m_size; i++) {
+            if (m_data[i] == '\n')
+                m_line_starts.push_back(m_base + i + 1);
+        }
+    }
+    auto it = std::upper_bound(m_line_starts.begin(), m_line_starts.end(), offset);
+    size_t line = it == m_line_starts.begin() ? 0 : (it - m_line_starts.begin()) - 1;
+    return std::make_pair(m_base_line + line, offset - m_line_starts[line]);
 }
 
-bool lexer::is_alpha()
+
+// Informações do token atual, a linha e coluna são calculadas aqui para
+// que o caminho normal do analisador não precise contar linhas.
+const token_info& lexer::get_token_info()
 {
-    char c = get_char();
-    return std::isalpha(c) || is_char('_');
+    if (m_count == 0)
+        fill(1);
+    auto pos = line_column(current().start);
+    m_tok_info.type = current().type;
+    m_tok_info.lineno = pos.first;
+    m_tok_info.start = pos.second;
+    m_tok_info.end = pos.second + current().length;
+    m_tok_info.token = token();
+    return m_tok_info;
 }
 
-int lexer::get_token()
+
+lexer::lexer()
 {
-    // verifica se o último token foi consumido
-    if (!m_consumed)
-        return m_type;
+}
 
-    m_consumed = false;
+// Analisa o próximo token a partir da posição atual do buffer, sua faixa
+// fica em m_tok_start e m_tok_len.
+int lexer::scan()
+{
     set_type(tok::eof);
-    m_token.clear();
 
-    try {
-        ignore_comments();
-        // vamos trabalhar com dois caracteres em seguida
-        char ahead = peek_next();
+    ignore_comments();
+    mark();
 
-        int digits = 0;
+    // vamos trabalhar com dois caracteres em seguida
+    char ahead = peek_next();
+    auto start = offset();
 
-        // Verifica por números
-        if (is_digit()) {
-            auto start = m_position;
+    switch (char_class(get_char())) {
+    case cc_eof:
+        copy_token(start);
+        break;
 
-            while (is_digit()) {
-                next_char();
-                digits++;
-            }
-            copy_token(start);
-            set_type(tok::integer);
-        }
-        // identificadores ou keywords
-        else if (is_alpha()) {
-            auto start = m_position;
-            while (is_alnum())
-                next_char();
+    // Verifica por números
+    case cc_digit:
+        while (is_class(cc_digit))
+            next_char();
+        copy_token(start);
+        set_type(tok::integer);
+        break;
 
-            copy_token(start);
+    // identificadores ou keywords
+    case cc_alpha:
+        while (is_class(cc_alpha | cc_digit))
+            next_char();
+        copy_token(start);
 
-            // verifica se é uma palavra reservada
-            if (!check_for_keyword())
-                set_type(tok::identifier);
-        }
-        else if (is_char('^') || is_char('@')) {
-            auto start = m_position;
-            auto lstart = m_line;
+        // verifica se é uma palavra reservada
+        if (!check_for_keyword())
+            set_type(tok::identifier);
+        break;
+
+    case cc_prefix:
+        next_char();
+        while (is_class(cc_alpha))
             next_char();
-            while (is_alpha()) {
-                next_char();
-            }
-
-            copy_token(start);
-            // verifica se é uma palavra reservada
-            if (!check_for_keyword()) {
-                auto em = fmt::sprintf("Palavra reservada <font color=\"red\"><b>%s</b></font>"
-                                       " inválida na linha %d:%d\n",
-                                       m_token.c_str(), (lstart + 1), (start + 1));
-                throw lexer_error(em);
-            }
+        copy_token(start);
+
+        // verifica se é uma palavra reservada
+        if (!check_for_keyword()) {
+            auto pos = line_column(start);
+            auto em = fmt::sprintf("Palavra reservada <font color=\"red\"><b>%s</b></font>"
+                                   " inválida na linha %d:%d\n",
+                                   scanned_text(), (pos.first + 1), (pos.second + 1));
+            throw lexer_error(em);
         }
-        else if (is_char('"')) {
-            auto start = m_position;
-            auto lstart = m_line;
-            set_type(tok::string);
+        break;
 
-            try {
-                next_char();
-                while (!is_char('"'))
-                    next_char();
-                next_char();
-            } catch (const eof_except& e) {
-                auto em = fmt::sprintf("Final do arquivo inesperado.\n"
-                                       "Problema na string iniciada na linha %d:%d.\n"
-                                       "Provavelmente a string não foi fechada!",
-                                       (lstart + 1), (start + 1));
-                throw lexer_error(em);
-            }
-
-            copy_token(start);
+    case cc_quote:
+        set_type(tok::string);
+        next_char();
+        skip_until('"', false);
+        if (get_char() == '\0') {
+            auto pos = line_column(start);
+            auto em = fmt::sprintf("Final do arquivo inesperado.\n"
+                                   "Problema na string iniciada na linha %d:%d.\n"
+                                   "Provavelmente a string não foi fechada!",
+                                   (pos.first + 1), (pos.second + 1));
+            throw lexer_error(em);
         }
-        // delimitadores
-        else if (is_delim()) {
-            auto start = m_position;
-            auto lstart = m_line;
-
-            switch (get_char()) {
-            case '!': {
-                if (ahead == '=')
-                    next_char();
-                break;
-            }
-
-            case ':': {
-                if (ahead == '=')
-                    next_char();
-                break;
-            }
-
-            case '<': {
-                if (ahead == '=')
-                    next_char();
-                break;
-            }
-
-            case '>': {
-                if (ahead == '=')
-                    next_char();
-                break;
-            }
-
-            default:
-                break;
-            }
-
+        next_char();
+        copy_token(start);
+        break;
+
+    // delimitadores
+    case cc_delim: {
+        // operadores de dois caractéres: != := <= >=
+        char c = get_char();
+        if (ahead == '=' && (c == '!' || c == ':' || c == '<' || c == '>'))
             next_char();
-            copy_token(start);
-
-            // verifica se é uma palavra reservada
-            if (!check_for_keyword()) {
-                auto em = fmt::sprintf("Sequência inválida `%s` na linha %d:%d.",
-                                       m_token, (lstart + 1), (start + 1));
-                throw lexer_error(em);
-            }
-
-        } else {
-            // encontrou alguma coisa inválida...
-            auto em = fmt::sprintf("Caractér inválido `%c` na linha %d:%d.",
-                                   get_char(), (m_line + 1), (m_position + 1));
+        next_char();
+        copy_token(start);
+
+        // verifica se é uma palavra reservada
+        if (!check_for_keyword()) {
+            auto pos = line_column(start);
+            auto em = fmt::sprintf("Sequência inválida `%s` na linha %d:%d.",
+                                   scanned_text(), (pos.first + 1), (pos.second + 1));
             throw lexer_error(em);
         }
+        break;
+    }
 
-    } catch (const eof_except& e) {
-        set_type(tok::eof);
+    default: {
+        // encontrou alguma coisa inválida...
+        auto pos = line_column(offset());
+        auto em = fmt::sprintf("Caractér inválido `%c` na linha %d:%d.",
+                               get_char(), (pos.first + 1), (pos.second + 1));
+        throw lexer_error(em);
     }
+    }
+
     return m_type;
 }
 
 
-// Função que devolve a classe do próximo token no buffer de caractéres, sem
-// alterar o estado do analisador léxico. 
+// Analisa tokens até o buffer circular ter pelo menos count tokens
+void lexer::fill(size_t count)
+{
+    if (count > ring_size)
+        throw lexer_error("Lookahead maior que o suportado pelo analisador léxico");
+
+    while (m_count < count) {
+        int type = scan();
+        auto& tok = m_ring[(m_head + m_count) % ring_size];
+        tok.type = type;
+        tok.start = m_tok_start;
+        tok.length = m_tok_len;
+        m_count++;
+    }
+}
+
+
+// Função que devolve a classe do token n posições à frente, sem alterar o
+// estado do analisador léxico.
+int lexer::peek_token(size_t n)
+{
+    if (m_count <= n)
+        fill(n + 1);
+    return m_ring[(m_head + n) % ring_size].type;
+}
+
+
+// Função que devolve a classe do token seguinte ao último retornado por
+// get_token().
 int lexer::peek_next_token()
 {
-    const auto& pos = get_local();
-    auto consumed = m_consumed;
-    auto token = m_token;
-
-    int type = tok::eof;
-    try {
-        m_consumed = true;
-        type = get_token();
-    } catch (const eof_except& e) {
-        type = tok::eof;
+    return peek_token(m_consumed ? 0 : 1);
+}
+
+
+// Lê o próximo bloco do stream para o buffer. Só o texto a partir do token
+// mais antigo ainda em uso (o primeiro do buffer circular ou o que está
+// sendo analisado) é mantido, o resto é descartado depois de contar suas
+// linhas. Retorna false se não há mais nada para ler.
+bool lexer::refill()
+{
+    if (!m_stream || m_stream_eof)
+        return false;
+
+    size_t keep = m_scan_start;
+    if (m_count > 0)
+        keep = std::min(keep, current().start);
+    keep -= m_base;
+
+    for (size_t i = 0; i < keep; i++) {
+        if (m_data[i] == '\n') {
+            m_base_line++;
+            m_base_line_start = m_base + i + 1;
+        }
+    }
+    size_t rest = m_size - keep;
+    m_text.erase(0, keep);
+    m_text.resize(rest + stream_chunk + charscan::padding);
+    m_base += keep;
+    m_position -= keep;
+
+    size_t count = 0;
+    while (count == 0 && !m_stream_eof) {
+        m_stream->read(&m_text[rest], stream_chunk);
+        count = static_cast<size_t>(m_stream->gcount());
+        m_stream_eof = !*m_stream;
     }
 
-    m_token = token;
-    m_consumed = consumed;
-    set_local(pos);
-    return type;
+    // sentinela e preenchimento logo depois do que foi lido
+    m_text.resize(rest + count);
+    m_text.append(charscan::padding, '\0');
+    m_data = m_text.c_str();
+    m_size = rest + count;
+    m_line_starts.clear();
+    return count > 0;
 }
 
 
-// Abre um arquivo de texto e copia todo seu conteúdo para o buffer
-// de caractéres.
+// Aponta o analisador para um novo buffer de caractéres, data[size] deve
+// ser o '\0' sentinela.
+void lexer::set_buffer(const char *data, size_t size)
+{
+    m_data = data;
+    m_size = size;
+    m_position = 0;
+    m_is_open = true;
+}
+
+
+void lexer::reset()
+{
+#ifdef PTB_HAS_MMAP
+    if (m_mapping)
+        munmap(m_mapping, m_mapping_size);
+#endif
+    m_mapping = nullptr;
+    m_mapping_size = 0;
+    m_text.clear();
+    m_data = m_text.c_str();
+    m_size = 0;
+    m_position = 0;
+    m_base = 0;
+    m_base_line = 0;
+    m_base_line_start = 0;
+    m_scan_start = 0;
+    m_stream = nullptr;
+    m_stream_eof = false;
+    m_tok_start = 0;
+    m_tok_len = 0;
+    m_head = 0;
+    m_count = 0;
+    m_line_starts.clear();
+    m_is_open = false;
+    m_consumed = true;
+}
+
+
+lexer::~lexer()
+{
+    reset();
+}
+
+
+// Abre um arquivo de texto e usa todo seu conteúdo como buffer de
+// caractéres. Quando o sistema suporta, o arquivo é mapeado em memória,
+// senão é lido de uma vez só em m_text.
+// O mapeamento só é usado quando o tamanho do arquivo não é múltiplo do
+// tamanho da página, assim o resto da última página (preenchido com zeros
+// pelo sistema) serve de sentinela.
 void lexer::open(const std::string& name)
 {
     reset();
 
+#ifdef PTB_HAS_MMAP
+    int fd = ::open(name.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw std::runtime_error("Não foi possível abrir o arquivo");
+
+    struct stat st;
+    long page = sysconf(_SC_PAGESIZE);
+    if (fstat(fd, &st) == 0 && st.st_size > 0 && page > 0 &&
+            (st.st_size % page) != 0) {
+        void *addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr != MAP_FAILED) {
+            m_mapping = addr;
+            m_mapping_size = st.st_size;
+        }
+    }
+    close(fd);
+
+    if (m_mapping) {
+        set_buffer(static_cast<const char *>(m_mapping), m_mapping_size);
+        return;
+    }
+#endif
+
     // Tenta abrir o arquivo
     std::ifstream file;
-    file.open(name, std::ios_base::in);
+    file.open(name, std::ios_base::in | std::ios_base::binary);
     if (!file.is_open())
         throw std::runtime_error("Não foi possível abrir o arquivo");
 
-    std::string line;
-    while (std::getline(file, line))
-        m_lines.push_back(line);
+    file.seekg(0, std::ios_base::end);
+    auto size = file.tellg();
+    file.seekg(0, std::ios_base::beg);
+    size_t length = 0;
+    if (size > 0) {
+        m_text.resize(static_cast<size_t>(size) + charscan::padding);
+        file.read(&m_text[0], size);
+        length = static_cast<size_t>(file.gcount());
+    }
+    // sentinela e preenchimento para a varredura em blocos
+    m_text.resize(length);
+    m_text.append(charscan::padding, '\0');
+    set_buffer(m_text.c_str(), length);
+}
 
-    m_is_open = true;
+// Lê o programa de um stream (a entrada padrão, por exemplo) aos poucos,
+// em blocos de stream_chunk bytes, com memória limitada ao bloco atual e
+// aos tokens do lookahead.
+void lexer::open(std::istream& in)
+{
+    reset();
+
+    m_stream = &in;
+    m_text.assign(charscan::padding, '\0');
+    set_buffer(m_text.c_str(), 0);
 }
 
 void lexer::load_text(const std::string& text)
 {
     reset();
 
-    std::istringstream textstream(text);
-    std::string line;
-    while (std::getline(textstream, line, '\n'))
-        m_lines.push_back(line);
-    m_is_open = true;
+    m_text.reserve(text.size() + charscan::padding);
+    m_text = text;
+    m_text.append(charscan::padding, '\0');
+    set_buffer(m_text.c_str(), text.size());
 }
 
 }
@@ -4,9 +4,10 @@
 
 #pragma once
 
+#include <stdexcept>
+#include <istream>
 #include <string>
 #include <vector>
-#include <unordered_map>
 #include <utility>
 
 namespace ptb
@@ -25,58 +26,94 @@ struct token_info {
     int type;
 };
 
+// Token já analisado: a classe e a faixa que ele ocupa no buffer
+struct token_ref {
+    int type;
+    size_t start;
+    size_t length;
+};
+
 class lexer
 {
     bool m_is_open = false;
-    std::vector<std::string> m_lines;
-    std::string m_token;
+    // Buffer contíguo com todo o programa, aponta para o arquivo mapeado
+    // em memória ou para m_text. m_data[m_size] é sempre '\0'.
+    const char *m_data = "";
+    size_t m_size = 0;
+    std::string m_text;
+    void *m_mapping = nullptr;
+    size_t m_mapping_size = 0;
+
+    // Leitura de um stream: o buffer guarda só uma janela do texto que
+    // começa no offset m_base. Os offsets dos tokens são sempre relativos
+    // ao começo do texto, não da janela.
+    static const size_t stream_chunk = 64 * 1024;
+    std::istream *m_stream = nullptr;
+    bool m_stream_eof = false;
+    size_t m_base = 0;
+    // linhas antes da janela e o offset onde começa a linha de m_base
+    size_t m_base_line = 0;
+    size_t m_base_line_start = 0;
+    // início do texto que ainda não pode ser descartado da janela
+    size_t m_scan_start = 0;
+    // Offset do início de cada linha, só é construído quando algum
+    // diagnóstico precisa de linha/coluna.
+    std::vector<size_t> m_line_starts;
+    // Faixa do buffer do token sendo analisado:
+    // [m_tok_start, m_tok_start + m_tok_len)
+    size_t m_tok_start = 0;
+    size_t m_tok_len = 0;
     int m_type = 0;
     bool m_consumed = true;
-    size_t m_line = 0;
     size_t m_position = 0;
     token_info m_tok_info;
 
+    // Buffer circular com os tokens já analisados. m_ring[m_head] é o token
+    // atual e os seguintes são o lookahead, então olhar N tokens à frente é
+    // só um acesso ao vetor.
+    static const size_t ring_size = 8;
+    token_ref m_ring[ring_size];
+    size_t m_head = 0;
+    size_t m_count = 0;
+
     inline char get_char();
     inline void next_char();
     inline void back_char();
     inline char peek_next();
+    inline void skip_until(char c, bool discard);
     inline void ignore_spaces();
     inline void ignore_comments();
-    inline bool is_digit();
     inline bool is_char(char c);
-    inline bool is_alpha();
-    inline bool is_alnum();
-    inline bool is_delim(char c);
-    inline bool is_delim();
+    inline bool is_class(unsigned char mask);
 
-    std::unordered_map<std::string, int> m_keywords;
+    std::pair<size_t, size_t> line_column(size_t offset);
 
-    typedef std::pair<size_t, size_t> local_t;
-
-    local_t get_local() {
-        return std::make_pair(m_line, m_position);
+    bool check_for_keyword();
+    void copy_token(size_t start);
+    std::string scanned_text() const {
+        return std::string(m_data + (m_tok_start - m_base), m_tok_len);
     }
 
-    void set_local(const local_t& pos) {
-        m_line = pos.first;
-        m_position = pos.second;
+    // offset da posição atual a partir do começo do texto
+    size_t offset() const {
+        return m_base + m_position;
     }
-
-    bool check_for_keyword();
-    void copy_token(size_t start);
+    // o texto antes da posição atual pode ser descartado
+    void mark() {
+        m_scan_start = offset();
+    }
+    bool refill();
 
     inline void set_type(int type) {
         m_type = type;
-        m_tok_info.type = type;
     }
 
-    void reset() {
-        m_line = 0;
-        m_position = 0;
-        m_lines.clear();
-        m_token.clear();
-        m_is_open = false;
-        m_consumed = true;
+    void reset();
+    void set_buffer(const char *data, size_t size);
+    int scan();
+    void fill(size_t count);
+    const token_ref& current() const {
+        return m_ring[m_head];
     }
 
 public:
@@ -85,23 +122,54 @@ public:
 
     // Não é copiável
     lexer(const lexer&) = delete;
-
-    int get_token();
-    const token_info& get_token_info() const {
-        return m_tok_info;
+    ~lexer();
+
+    // Retorna a classe do token atual, que continua sendo o mesmo até ser
+    // consumido.
+    int get_token() {
+        if (m_count == 0)
+            fill(1);
+        m_consumed = false;
+        return current().type;
     }
+    const token_info& get_token_info();
+
+    // Classe do token n posições à frente, sem alterar o estado do
+    // analisador. peek_token(0) é o token que get_token() vai retornar.
+    int peek_token(size_t n);
     int peek_next_token();
-    const std::string& token() const {
-        return m_token;
+
+    // Texto do token atual, aponta para dentro do buffer e não é terminado
+    // por '\0'. Só é válido até a próxima leitura de token.
+    const char *token_text() const {
+        return m_data + (current().start - m_base);
+    }
+    size_t token_length() const {
+        return current().length;
     }
+    // Cópia do texto do token atual
+    std::string token() const {
+        return std::string(token_text(), token_length());
+    }
+
+    // Tipo da palavra reservada ou operador em [s, s + n), ou -1 se a
+    // palavra não for reservada
+    static int keyword_type(const char *s, size_t n);
 
     void open(const std::string& name);
+    void open(std::istream& in);
     void load_text(const std::string& text);
     bool is_open() const {
         return m_is_open;
     }
 
+    // Descarta o token atual, consumir duas vezes sem ler um novo token não
+    // tem efeito.
     void consume() {
+        if (!m_consumed && m_count > 0) {
+            m_head = (m_head + 1) % ring_size;
+            m_count--;
+        }
         m_consumed = true;
     }
 };
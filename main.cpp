@@ -2,16 +2,24 @@
 // Pararatibum - A linguagem do momento
 // -----------------------------------------------------------------------------
 
+#include <fstream>
 #include <iostream>
 #include <exception>
 #include <stdexcept>
+#include "arena.h"
 #include "lexer.h"
+#include "lexbench.h"
 #include "parser.h"
 #include "codegen.h"
 #include "analyzer.h"
 #include "dotexport.h"
+#include "flatast.h"
 #include "tokens.h"
 #include "jvmcodegen.h"
+#include "optimizer.h"
+#include "irbuilder.h"
+#include "irpass.h"
+#include "timing.h"
 
 using namespace std;
 
@@ -19,26 +27,132 @@ int main(int argc, char **argv)
 {
     try {
         fmt::printf("Compilador de PararaTibum - A linguagem do momento\n");
-        if (argc < 2) {
-            fmt::printf("Utilizar ptbc <arquivo>\n");
+        std::string filename;
+        bool optimize = false;
+        bool dump_ir = false;
+        bool show_times = false;
+        bool write_class = false;
+        bool write_ast = false;
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            if (arg == "-O1") {
+                optimize = true;
+            } else if (arg == "-O0") {
+                optimize = false;
+            } else if (arg == "-ir") {
+                dump_ir = true;
+            } else if (arg == "-tempo") {
+                show_times = true;
+            } else if (arg == "-class") {
+                write_class = true;
+            } else if (arg == "-ast") {
+                write_ast = true;
+            } else if (arg == "-bench-lexer") {
+                ptb::bench_lexer(std::cout);
+                return 0;
+            } else if (arg == "-bench-keywords") {
+                ptb::bench_keywords(std::cout);
+                return 0;
+            } else {
+                filename = arg;
+            }
+        }
+        if (filename.empty()) {
+            fmt::printf("Utilizar ptbc [-O0|-O1] [-ir] [-tempo] [-class] [-ast] <arquivo>\n");
+            fmt::printf("Use - como arquivo para ler o programa da entrada padrao\n");
+            fmt::printf("-O1 habilita as otimizacoes\n");
+            fmt::printf("-ir grava a representacao intermediaria em ptb.ir\n");
+            fmt::printf("-tempo mostra o tempo gasto em cada fase e passe\n");
+            fmt::printf("-class grava ptb.class direto, sem precisar do Jasmin\n");
+            fmt::printf("-ast grava a AST compacta em ptb.ast\n");
+            fmt::printf("Um arquivo .ast gravado com -ast e lido e exportado para ast.dot\n");
+            fmt::printf("ptbc -bench-lexer mede o analisador lexico num programa de 50 MB\n");
+            fmt::printf("ptbc -bench-keywords mede o reconhecimento de palavras reservadas\n");
+            return 0;
+        }
+        if (filename.size() > 4 &&
+            filename.compare(filename.size() - 4, 4, ".ast") == 0) {
+            std::ifstream in(filename, std::ios::binary);
+            if (!in) {
+                throw std::runtime_error("Nao foi possivel abrir " + filename);
+            }
+            ptb::ast::flat_tree tree;
+            tree.read(in);
+            ptb::dotexport().run(tree);
+            fmt::printf("AST exportada para ast.dot\n");
             return 0;
         }
+        ptb::ir::timing().enable(show_times);
         ptb::lexer lex;
-        lex.open(argv[1]);
-        ptb::parser parser(lex);
+        if (filename == "-") {
+            lex.open(std::cin);
+        } else {
+            lex.open(filename);
+        }
+        // todos os nós da AST vivem nesta arena e são liberados juntos
+        ptb::arena nodes;
+        ptb::parser parser(lex, nodes);
         ptb::analyzer semantic;
         ptb::code_gen gen;
         ptb::dotexport dotter;
-        ptb::jvmcodegen jvmcg;
+        ptb::jvmcodegen jvmcg(write_class ? ptb::jvmcodegen::classfile
+                                          : ptb::jvmcodegen::jasmin);
+        jvmcg.set_peephole(optimize ? ptb::jvm::peephole::all_rules
+                                    : ptb::jvm::peephole::no_rules);
+        ptb::optimizer opt(nodes);
 
-        parser.run();
+        {
+            ptb::ir::scoped_timer timer("parser");
+            parser.run();
+        }
         const auto& ast = parser.get_ast();
-        semantic.run(ast);
+        {
+            ptb::ir::scoped_timer timer("analyzer");
+            semantic.run(ast);
+        }
+        if (optimize) {
+            ptb::ir::scoped_timer timer("optimizer");
+            opt.run(ast);
+        }
         dotter.run(ast);
-        gen.translate(ast);
-        auto symtbl = semantic.get_symtable();
-        jvmcg.run(ast, symtbl);
+        if (write_ast) {
+            std::ofstream out("ptb.ast", std::ios::binary);
+            ptb::ast::flat_tree(ast).write(out);
+        }
+
+        // os dois geradores de código partem da mesma IR
+        ptb::ir::module module;
+        ptb::ir::builder builder;
+        {
+            ptb::ir::scoped_timer timer("ir_builder");
+            builder.run(ast, module);
+        }
+        ptb::ir::pass_manager passes;
+        passes.add<ptb::ir::remove_unreachable>();
+        if (optimize) {
+            passes.add<ptb::ir::simplify_cfg>();
+            passes.add<ptb::ir::propagate_constants>();
+            passes.add<ptb::ir::eliminate_dead_code>();
+            // limpa os blocos que os desvios constantes deixaram para trás
+            passes.add<ptb::ir::simplify_cfg>();
+        }
+        passes.run(module);
+        if (dump_ir) {
+            std::ofstream out("ptb.ir");
+            ptb::ir::print(out, module);
+        }
+        {
+            ptb::ir::scoped_timer timer("codegen");
+            gen.translate(module);
+        }
+        {
+            ptb::ir::scoped_timer timer("jvmcodegen");
+            jvmcg.run(module);
+        }
         fmt::printf("Program compilado com sucesso!\n");
+        if (show_times) {
+            ptb::ir::timing().print(std::cout);
+        }
     } catch (std::exception const &e) {
         std::cerr << e.what() << std::endl;
     }
@@ -4,8 +4,10 @@
 
 // Otimizações: Dead Code Elimination, Constant Folding
 
+#include <cstdint>
 #include "optimizer.h"
 #include "tokens.h"
+#include "types.h"
 
 namespace ptb {
 
@@ -15,35 +17,126 @@ enum {
     already_folded,
 };
 
-optimizer::optimizer()
+optimizer::optimizer(arena &nodes) :
+    m_nodes(nodes), m_folded(0), m_eliminated(0), m_in_function(false)
 {
 }
 
 void optimizer::run(const ast::node_ptr &node)
 {
+    m_folded = 0;
+    m_eliminated = 0;
+    ast::node_ptr root = node;
+    fold_pass(root);
 
+    // remover uma declaração pode deixar sem uso as variáveis do seu
+    // inicializador, então repete até não haver mudança
+    size_t eliminated;
+    do {
+        eliminated = m_eliminated;
+        m_uses.clear();
+        count_uses(root);
+        dce_pass(root);
+    } while (eliminated != m_eliminated);
 }
 
-void optimizer::fold_pass(const ast::node_ptr &node)
+void optimizer::fold_list(const ast::node_list &list)
 {
+    for (auto& item : list) {
+        fold_pass(item);
+    }
+}
+
+// Constant folding: percorre a árvore e substitui, de baixo para cima, cada
+// operação cujos operandos são constantes por um ast::integer. Como os
+// filhos são dobrados antes, cada nó é avaliado uma única vez.
+void optimizer::fold_pass(ast::node_ptr &node)
+{
+    switch (node->type) {
+    case ast::op_arithm_node: {
+        auto op = ast::to_op_arithm(node);
+        fold_pass(op->left);
+        fold_pass(op->right);
+        break;
+    }
+    case ast::op_logical_node: {
+        auto op = ast::to_op_logical(node);
+        fold_pass(op->left);
+        fold_pass(op->right);
+        break;
+    }
+    case ast::program_node:
+        fold_list(ast::to_program(node)->declarations);
+        return;
+    case ast::function_decl_node:
+        fold_list(ast::to_function_decl(node)->statements);
+        return;
+    case ast::variable_decl_node:
+        fold_pass(ast::to_variable_decl(node)->value);
+        return;
+    case ast::assign_stmt_node:
+        fold_pass(ast::to_assign_stmt(node)->rvalue);
+        return;
+    case ast::return_stmt_node:
+        fold_pass(ast::to_return_stmt(node)->expr);
+        return;
+    case ast::write_stmt_node:
+        fold_pass(ast::to_write_stmt(node)->expr);
+        return;
+    case ast::call_node:
+        fold_list(ast::to_call(node)->param_list);
+        return;
+    case ast::if_stmt_node: {
+        auto ifstmt = ast::to_if_stmt(node);
+        fold_pass(ifstmt->eval_expr);
+        fold_list(ifstmt->true_statements);
+        fold_list(ifstmt->false_statements);
+        return;
+    }
+    case ast::while_stmt_node: {
+        auto whilestmt = ast::to_while_stmt(node);
+        fold_pass(whilestmt->eval_expr);
+        fold_list(whilestmt->statements);
+        return;
+    }
+    default:
+        return;
+    }
+
+    if (can_fold(node) == can_be_folded) {
+        // o literal herda o tipo já calculado (booleano para comparações)
+        int eval_type = node->eval_type;
+        node = ast::make_integer(m_nodes, fold_expr(node));
+        node->eval_type = eval_type;
+        m_folded++;
+    }
 }
 
+// Avalia a expressão com a aritmética de 32 bits da JVM: soma, subtração e
+// multiplicação dão a volta em caso de overflow e INT_MIN / -1 = INT_MIN.
 int optimizer::fold_expr(const ast::node_ptr &node)
 {
     switch (node->type) {
         case ast::integer_node: return ast::to_integer(node)->value;
         case ast::op_arithm_node: {
             auto op = ast::to_op_arithm(node);
+            uint32_t lhs = static_cast<uint32_t>(fold_expr(op->left));
+            uint32_t rhs = static_cast<uint32_t>(fold_expr(op->right));
             switch (op->op) {
-                case '+': return fold_expr(op->left) + fold_expr(op->right);
-                case '-': return fold_expr(op->left) - fold_expr(op->right);
-                case '*': return fold_expr(op->left) * fold_expr(op->right);
-                case '/': {
-                    int den = fold_expr(op->right);
+                case '+': return static_cast<int32_t>(lhs + rhs);
+                case '-': return static_cast<int32_t>(lhs - rhs);
+                case '*': return static_cast<int32_t>(lhs * rhs);
+                case '/':
+                case '%': {
+                    int32_t num = static_cast<int32_t>(lhs);
+                    int32_t den = static_cast<int32_t>(rhs);
                     if (den == 0) {
                         throw optimizer_error("Divisao por zero encontrada!");
                     }
-                    return fold_expr(op->left) / den;
+                    if (num == INT32_MIN && den == -1) {
+                        return op->op == '/' ? INT32_MIN : 0;
+                    }
+                    return op->op == '/' ? num / den : num % den;
                 }
             }
             break;
@@ -63,6 +156,7 @@ int optimizer::fold_expr(const ast::node_ptr &node)
             break;
         }
     }
+    throw optimizer_error("Expressao constante invalida");
 }
 
 int optimizer::can_fold(const ast::node_ptr &node)
@@ -97,6 +191,199 @@ int optimizer::can_fold(const ast::node_ptr &node)
     case ast::read_stmt_node: return 0;
     case ast::write_stmt_node: return 0;
     }
+    return 0;
+}
+
+// Dead code elimination: reconstrói cada bloco sem os statements que
+// seguem um ^senta, sem os ^pedindo_mais de condição falsa, sem as
+// declarações locais nunca usadas e com os ^parara de condição constante
+// trocados pelo ramo escolhido. Deve rodar depois do constant folding.
+void optimizer::dce_pass(const ast::node_ptr &node)
+{
+    switch (node->type) {
+    case ast::program_node:
+        for (auto& decl : ast::to_program(node)->declarations) {
+            dce_pass(decl);
+        }
+        break;
+    case ast::function_decl_node:
+        m_in_function = true;
+        dce_list(ast::to_function_decl(node)->statements);
+        m_in_function = false;
+        break;
+    default:
+        break;
+    }
+}
+
+void optimizer::dce_list(ast::node_list &list)
+{
+    size_t mark = m_pending.size();
+    for (size_t i = 0; i < list.size(); i++) {
+        dce_stmt(list[i]);
+        if (m_pending.size() > mark &&
+            m_pending.back()->type == ast::return_stmt_node) {
+            // nada depois do retorno é executado
+            m_eliminated += list.size() - i - 1;
+            break;
+        }
+    }
+
+    size_t count = m_pending.size() - mark;
+    if (count <= list.size()) {
+        // a lista só encolheu: reaproveita o vetor que já está na arena
+        for (size_t i = 0; i < count; i++) {
+            list[i] = m_pending[mark + i];
+        }
+        list.count = count;
+    } else {
+        list = ast::make_list(m_nodes, m_pending.data() + mark, count);
+    }
+    m_pending.resize(mark);
+}
+
+void optimizer::dce_stmt(const ast::node_ptr &node)
+{
+    switch (node->type) {
+    case ast::if_stmt_node: {
+        auto ifstmt = ast::to_if_stmt(node);
+        dce_list(ifstmt->true_statements);
+        dce_list(ifstmt->false_statements);
+        if (ifstmt->eval_expr->type != ast::integer_node) {
+            break;
+        }
+        bool taken = ast::to_integer(ifstmt->eval_expr)->value != 0;
+        auto& branch = taken ? ifstmt->true_statements : ifstmt->false_statements;
+        int scope_id = taken ? ifstmt->true_scope_id : ifstmt->false_scope_id;
+        for (const auto& stmt : branch) {
+            if (stmt->type == ast::variable_decl_node) {
+                // o ramo declara variáveis e precisa continuar num bloco
+                // próprio para não colidir com as do bloco de fora
+                if (!taken) {
+                    ifstmt->eval_expr = ast::make_integer(m_nodes, 1);
+                    ifstmt->eval_expr->eval_type = types::boolean;
+                    ifstmt->true_statements = branch;
+                    ifstmt->true_scope_id = scope_id;
+                }
+                if (!taken || !ifstmt->false_statements.empty()) {
+                    ifstmt->false_statements = ast::node_list();
+                    ifstmt->false_scope_id = -1;
+                    m_eliminated++;
+                }
+                m_pending.push_back(node);
+                return;
+            }
+        }
+        m_eliminated++;
+        m_pending.insert(m_pending.end(), branch.begin(), branch.end());
+        return;
+    }
+    case ast::while_stmt_node: {
+        auto whilestmt = ast::to_while_stmt(node);
+        if (whilestmt->eval_expr->type == ast::integer_node &&
+            ast::to_integer(whilestmt->eval_expr)->value == 0) {
+            m_eliminated++;
+            return;
+        }
+        dce_list(whilestmt->statements);
+        break;
+    }
+    case ast::variable_decl_node: {
+        auto decl = ast::to_variable_decl(node);
+        if (m_in_function && decl->sym != nullptr &&
+            m_uses.find(decl->sym) == m_uses.end() && ast::is_pure(decl->value)) {
+            m_eliminated++;
+            return;
+        }
+        break;
+    }
+    default:
+        break;
+    }
+    m_pending.push_back(node);
+}
+
+void optimizer::count_uses(const ast::node_ptr &node)
+{
+    switch (node->type) {
+    case ast::variable_node: {
+        auto var = ast::to_variable(node);
+        if (var->sym != nullptr) {
+            m_uses[var->sym]++;
+        }
+        break;
+    }
+    case ast::read_stmt_node: {
+        auto read = ast::to_read_stmt(node);
+        if (read->sym != nullptr) {
+            m_uses[read->sym]++;
+        }
+        break;
+    }
+    case ast::op_arithm_node: {
+        auto op = ast::to_op_arithm(node);
+        count_uses(op->left);
+        count_uses(op->right);
+        break;
+    }
+    case ast::op_logical_node: {
+        auto op = ast::to_op_logical(node);
+        count_uses(op->left);
+        count_uses(op->right);
+        break;
+    }
+    case ast::program_node:
+        for (const auto& decl : ast::to_program(node)->declarations) {
+            count_uses(decl);
+        }
+        break;
+    case ast::function_decl_node:
+        for (const auto& stmt : ast::to_function_decl(node)->statements) {
+            count_uses(stmt);
+        }
+        break;
+    case ast::variable_decl_node:
+        count_uses(ast::to_variable_decl(node)->value);
+        break;
+    case ast::assign_stmt_node: {
+        auto assign = ast::to_assign_stmt(node);
+        count_uses(assign->lvalue);
+        count_uses(assign->rvalue);
+        break;
+    }
+    case ast::return_stmt_node:
+        count_uses(ast::to_return_stmt(node)->expr);
+        break;
+    case ast::write_stmt_node:
+        count_uses(ast::to_write_stmt(node)->expr);
+        break;
+    case ast::call_node:
+        for (const auto& param : ast::to_call(node)->param_list) {
+            count_uses(param);
+        }
+        break;
+    case ast::if_stmt_node: {
+        auto ifstmt = ast::to_if_stmt(node);
+        count_uses(ifstmt->eval_expr);
+        for (const auto& stmt : ifstmt->true_statements) {
+            count_uses(stmt);
+        }
+        for (const auto& stmt : ifstmt->false_statements) {
+            count_uses(stmt);
+        }
+        break;
+    }
+    case ast::while_stmt_node: {
+        auto whilestmt = ast::to_while_stmt(node);
+        count_uses(whilestmt->eval_expr);
+        for (const auto& stmt : whilestmt->statements) {
+            count_uses(stmt);
+        }
+        break;
+    }
+    default:
+        break;
+    }
 }
 
 }
@@ -5,6 +5,9 @@
 #pragma once
 #include <stdexcept>
 #include <string>
+#include <unordered_map>
+#include <vector>
+#include "arena.h"
 #include "ast.h"
 
 namespace ptb {
@@ -17,14 +20,36 @@ struct optimizer_error : public std::runtime_error {
 class optimizer
 {
 public:
-    optimizer();
+    // os nós criados pelo otimizador são alocados na arena da AST
+    optimizer(arena &nodes);
 
     void run(const ast::node_ptr &node);
 
+    // quantidade de expressões substituídas por constantes
+    size_t folded() const { return m_folded; }
+    // quantidade de statements removidos pela eliminação de código morto
+    size_t eliminated() const { return m_eliminated; }
+
 private:
-    void fold_pass(const ast::node_ptr &node);
+    void fold_pass(ast::node_ptr &node);
+    void fold_list(const ast::node_list &list);
     int fold_expr(const ast::node_ptr &node);
     int can_fold(const ast::node_ptr &node);
+
+    void dce_pass(const ast::node_ptr &node);
+    void dce_list(ast::node_list &list);
+    void dce_stmt(const ast::node_ptr &node);
+    void count_uses(const ast::node_ptr &node);
+
+    arena &m_nodes;
+    size_t m_folded;
+    size_t m_eliminated;
+
+    // statements mantidos das listas em reconstrução
+    std::vector<ast::node_ptr> m_pending;
+    // referências a cada variável no código ainda vivo
+    std::unordered_map<const symbol*, unsigned> m_uses;
+    bool m_in_function;
 };
 
 }
@@ -52,11 +52,12 @@
 //
 // expr   ::= expr_0 log expr_0 | expr_0
 //
-// expr_0 ::= expr_1 '+' expr_1 | expr_1 '-' expr_1 | expr_1
+// expr_0 ::= expr_1 { ('+' | '-') expr_1 }
 //
-// expr_1 ::= atom '*' atom | atom '/' atom | atom '%' atom | atom
+// expr_1 ::= atom { ('*' | '/' | '%') atom }
 //
 // atom ::= '(' expr ')' | 'number' | 'literal' | identifier | '^esqueca' | '^faz'
+//        | '-' atom
 //
 // identifier ::= 'ident'
 //              | 'ident' '(' param_list ')'
@@ -82,7 +83,8 @@ namespace ptb
 
 using namespace ast;
 
-parser::parser(ptb::lexer& lex) : m_lex(lex)
+parser::parser(ptb::lexer& lex, arena& nodes) : m_lex(lex), m_nodes(nodes),
+    m_program(empty_node())
 {
     if (!m_lex.is_open())
         throw parser_error("Nenhuma arquivo carregado no analisador léxico!");
@@ -91,6 +93,7 @@ parser::parser(ptb::lexer& lex) : m_lex(lex)
 void parser::run()
 {
     m_main_defined = false;
+    m_pending.clear();
     try {
         m_lex.get_token();
         m_program = parse_program();
@@ -129,7 +132,7 @@ void parser::expect_error_(const std::string &expected)
 // program ::= decl_list
 node_ptr parser::parse_program()
 {
-    return make_program(std::move(parse_decl_list()));
+    return make_program(m_nodes, parse_decl_list());
 }
 
 
@@ -150,7 +153,7 @@ node_ptr parser::parse_decl()
         if (m_main_defined) {
             throw parser_error("A funcao main ja foi definida!");
         }
-        auto name = m_lex.token();
+        name_id name = intern_token();
         next();
         match(tok::l_par, "(");
         match(tok::r_par, ")");
@@ -158,15 +161,14 @@ node_ptr parser::parse_decl()
         auto stmts = parse_stmt_list();
         match(tok::r_curlbracket, "}");
         m_main_defined = true;
-        auto type = make_type(types::integer);
-        auto args = std::vector<node_ptr>();
-        return make_function_decl(name, std::move(type), std::move(args),
-                                  std::move(stmts), false);
+        auto type = make_type(m_nodes, types::integer);
+        return make_function_decl(m_nodes, name, type, node_list(),
+                                  stmts, false);
     }
 
     auto type = parse_type();
     if (is_token(tok::eof)) {
-        return make_node();
+        return empty_node();
     }
     if (!type->is_valid()) {
         expect_error("a declaracao de uma funcao ou variavel");
@@ -174,64 +176,64 @@ node_ptr parser::parse_decl()
     if (!is_token(tok::identifier)) {
         expect_error("um identificador");
     }
-    std::string name = m_lex.token();
+    name_id name = intern_token();
     next();
     if (is_token(tok::semicolon)) {
         next();
-        return make_variable_decl(name, std::move(type), std::move(make_node()));
+        return make_variable_decl(m_nodes, name, type, empty_node());
     }
     if (is_token(tok::assign)) {
         next();
         auto expr = parse_expr();
         match(tok::semicolon, ";");
-        return make_variable_decl(name, std::move(type), std::move(expr));
+        return make_variable_decl(m_nodes, name, type, expr);
     }
     if (is_token(tok::l_par)) {
         next();
         auto args = parse_arg_list();
         match(tok::r_par, ")");
         if (is_token(tok::semicolon)) {
-            return make_function_decl(name, std::move(type), std::move(args),
-                                      std::move(std::vector<node_ptr>()), true);
+            return make_function_decl(m_nodes, name, type, args,
+                                      node_list(), true);
         }
         match(tok::l_curlbracket,"{");
         auto stmts = parse_stmt_list();
         match(tok::r_curlbracket,"}");
-        return make_function_decl(name, std::move(type), std::move(args),
-                                  std::move(stmts), false);
+        return make_function_decl(m_nodes, name, type, args,
+                                  stmts, false);
     }
 
-    return make_node();
+    return empty_node();
 }
 
 
 
 // decl_list ::= decl decl_list
-std::vector<node_ptr> parser::parse_decl_list()
+node_list parser::parse_decl_list()
 {
-    std::vector<node_ptr> decls;
+    size_t mark = begin_list();
     while (auto decl = parse_decl()) {
         if (!decl->is_valid()) {
             break;
         }
-        decls.push_back(std::move(decl));
+        m_pending.push_back(decl);
     }
-    return decls;
+    return end_list(mark);
 }
 
 // stmt_list ::= stmt
 //             | stmt stmt_list
 //             ;
-std::vector<node_ptr> parser::parse_stmt_list()
+node_list parser::parse_stmt_list()
 {
-    std::vector<node_ptr> stmts;
+    size_t mark = begin_list();
     while (auto stmt = parse_stmt()) {
         if (!stmt->is_valid()) {
             break;
         }
-        stmts.push_back(std::move(stmt));
+        m_pending.push_back(stmt);
     }
-    return stmts;
+    return end_list(mark);
 }
 
 // stmt ::= if_stmt | while_stmt | return_stmt | identifier_stmt
@@ -249,7 +251,7 @@ node_ptr parser::parse_stmt()
     case tok::read_: return parse_read_stmt();
     case tok::write_: return parse_write_stmt();
     default:
-        return make_node();
+        return empty_node();
     }
 }
 
@@ -282,13 +284,11 @@ node_ptr parser::parse_if_stmt()
 
             match(tok::r_curlbracket, "}");
 
-            return make_if_stmt(std::move(expr), std::move(true_stmts),
-                                std::move(false_stmts));
+            return make_if_stmt(m_nodes, expr, true_stmts, false_stmts);
         }
-        return make_if_stmt(std::move(expr), std::move(true_stmts),
-                            std::move(std::vector<node_ptr>()));
+        return make_if_stmt(m_nodes, expr, true_stmts, node_list());
     }
-    return make_node();
+    return empty_node();
 }
 
 // stmt ::= while_stmt
@@ -310,9 +310,9 @@ node_ptr parser::parse_while_stmt()
 
         match(tok::r_curlbracket, "}");
 
-        return make_while_stmt(std::move(expr), std::move(body));
+        return make_while_stmt(m_nodes, expr, body);
     }
-    return make_node();
+    return empty_node();
 }
 
 // stmt ::= return_stmt
@@ -323,9 +323,9 @@ node_ptr parser::parse_return_stmt()
         next();
         auto expr = parse_expr();
         match(tok::semicolon, ";");
-        return make_return_stmt(std::move(expr));
+        return make_return_stmt(m_nodes, expr);
     }
-    return make_node();
+    return empty_node();
 }
 
 // stmt ::= identifier_stmt
@@ -336,29 +336,29 @@ node_ptr parser::parse_return_stmt()
 node_ptr parser::parse_identifier_stmt()
 {
     if (is_token(tok::identifier)) {
-        auto var_name = m_lex.token();
+        name_id var_name = intern_token();
         next();
         // assign statement
         if (is_token(tok::assign)) {
-            auto var = make_variable(var_name);
+            auto var = make_variable(m_nodes, var_name);
             next();
             auto expr = parse_expr();
             match(tok::semicolon, ";");
-            return make_assign_stmt(std::move(var), std::move(expr));
+            return make_assign_stmt(m_nodes, var, expr);
         }
         if (is_token(tok::l_par)) {
             next();
             auto params = parse_param_list();
             match(tok::r_par, ")");
             match(tok::semicolon, ";");
-            return make_call(var_name, std::move(params), true);
+            return make_call(m_nodes, var_name, params, true);
         }
         auto token = m_lex.get_token_info();
         auto msg = fmt::sprintf("Esperado uma atribuição ou chamada na linha %d:%d, encontrado %s",
                                 token.lineno, token.start, token.token);
         throw parser_error(msg.c_str());
     }
-    return make_node();
+    return empty_node();
 }
 
 
@@ -371,20 +371,20 @@ node_ptr parser::parse_var_decl()
         if (!is_token(tok::identifier)) {
             expect_error("um identificador");
         }
-        std::string name = m_lex.token();
+        name_id name = intern_token();
         next();
         if (is_token(tok::semicolon)) {
             next();
-            return make_variable_decl(name, std::move(type), std::move(make_node()));
+            return make_variable_decl(m_nodes, name, type, empty_node());
         }
         if (is_token(tok::assign)) {
             next();
             auto expr = parse_expr();
             match(tok::semicolon, ";");
-            return make_variable_decl(name, std::move(type), std::move(expr));
+            return make_variable_decl(m_nodes, name, type, expr);
         }
     }
-    return make_node();
+    return empty_node();
 }
 
 
@@ -392,66 +392,97 @@ node_ptr parser::parse_var_decl()
 node_ptr parser::parse_expr()
 {
     auto p = parse_expr_0();
+    // sem operando à esquerda quem chamou acusa o operador inesperado
+    if (!p->is_valid()) {
+        return p;
+    }
 
     int log_op = parse_logical_op();
     if (log_op >= 0) {
         next();
         auto right = parse_expr();
-        return make_op_logical(log_op, std::move(p), std::move(right));
+        if (!right->is_valid()) {
+            expect_error("um operando");
+        }
+        return make_op_logical(m_nodes, log_op, p, right);
     }
     return p;
 }
 
 
-// expr_0 ::= expr_1 '+' expr_1 | expr_1 '-' expr_1 | expr_1
+// expr_0 ::= expr_1 { ('+' | '-') expr_1 }
+// Os operadores associam à esquerda: a - b - c é (a - b) - c
 node_ptr parser::parse_expr_0()
 {
     auto p = parse_expr_1();
+    if (!p->is_valid()) {
+        return p;
+    }
 
-    if (is_token(tok::plus) || is_token(tok::minus)) {
-        int type = m_lex.get_token();
+    while (is_token(tok::plus) || is_token(tok::minus)) {
+        int op = is_token(tok::plus) ? '+' : '-';
         next();
 
-        auto right = parse_expr_0();
-        if (type == tok::plus)
-            return make_op_arithm('+', std::move(p), std::move(right));
-
-        return make_op_arithm('-', std::move(p), std::move(right));
+        auto right = parse_expr_1();
+        if (!right->is_valid()) {
+            expect_error("um operando");
+        }
+        p = make_op_arithm(m_nodes, op, p, right);
     }
     return p;
 }
 
-// expr_1 ::= atom '*' atom | atom '/' atom | atom '%' atom | atom
+// expr_1 ::= atom { ('*' | '/' | '%') atom }
+// Os operadores associam à esquerda: a / b * c é (a / b) * c
 node_ptr parser::parse_expr_1()
 {
     auto p = parse_atom();
+    if (!p->is_valid()) {
+        return p;
+    }
 
-    if (is_token(tok::mul) || is_token(tok::div) || is_token(tok::mod)) {
-        int type = m_lex.get_token();
-
+    while (is_token(tok::mul) || is_token(tok::div) || is_token(tok::mod)) {
+        int op = is_token(tok::mul) ? '*' : is_token(tok::mod) ? '%' : '/';
         next();
-        auto right = parse_expr_1();
-        if (type == tok::mul)
-            return make_op_arithm('*', std::move(p), std::move(right));
-        if (type == tok::mod)
-            return make_op_arithm('%', std::move(p), std::move(right));
-        return make_op_arithm('/', std::move(p), std::move(right));
+
+        auto right = parse_atom();
+        if (!right->is_valid()) {
+            expect_error("um operando");
+        }
+        p = make_op_arithm(m_nodes, op, p, right);
     }
     return p;
 }
 
-// atom ::= '(' expr ')' | 'number' | 'literal' | identifier
+// atom ::= '(' expr ')' | 'number' | 'literal' | identifier | '-' atom
 node_ptr parser::parse_atom()
 {
+    // menos unário: -a é representado como 0 - a, que o otimizador
+    // transforma num literal negativo quando a é constante
+    if (is_token(tok::minus)) {
+        next();
+        auto operand = parse_atom();
+        if (!operand->is_valid()) {
+            expect_error("um operando");
+        }
+        return make_op_arithm(m_nodes, '-', make_integer(m_nodes, 0), operand);
+    }
     if (is_token(tok::integer)) {
-        int value = atoi(m_lex.token().c_str());
+        // converte direto do buffer do analisador léxico
+        const char *digits = m_lex.token_text();
+        unsigned value = 0;
+        for (size_t i = 0; i < m_lex.token_length(); i++)
+            value = value * 10 + (digits[i] - '0');
 
         next();
-        return make_integer(value);
+        return make_integer(m_nodes, static_cast<int>(value));
     }
     if (is_token(tok::l_par)) {
         next();
         auto t = parse_expr();
+        if (!t->is_valid()) {
+            expect_error("uma expressão");
+        }
         if (is_token(tok::r_par)) {
             next();
             return t;
@@ -464,23 +495,23 @@ node_ptr parser::parse_atom()
         }
     }
     if (is_token(tok::string)) {
-        auto lstr = m_lex.token();
+        name_id lstr = intern_token();
         next();
-        return make_lstring(lstr);
+        return make_lstring(m_nodes, lstr);
     }
     if (is_token(tok::identifier)) {
         return parse_identifier();
     }
     if (is_token(tok::true_)) {
         next();
-        return make_integer(1);
+        return make_integer(m_nodes, 1);
     }
     if (is_token(tok::false_)) {
         next();
-        return make_integer(0);
+        return make_integer(m_nodes, 0);
     }
 
-    return make_node();
+    return empty_node();
 }
 
 // identifier ::= 'ident'
@@ -492,15 +523,15 @@ node_ptr parser::parse_identifier()
     if (!is_token(tok::identifier)) {
         expect_error("um identificador");
     }
-    std::string name = m_lex.token();
+    name_id name = intern_token();
     next();
     if (is_token(tok::l_par)) {
         next();
         auto params = parse_param_list();
         match(tok::r_par, ")");
-        return make_call(name, std::move(params), false);
+        return make_call(m_nodes, name, params, false);
     }
-    return make_variable(name);
+    return make_variable(m_nodes, name);
 }
 
 // read_stmt ::=  '^mexer_com' '(' 'ident' ')' ';'
@@ -512,14 +543,14 @@ node_ptr parser::parse_read_stmt()
         if (!is_token(tok::identifier)) {
             expect_error_("identificador");
         }
-        std::string id = m_lex.token();
+        name_id id = intern_token();
         next();
         match(tok::r_par, ")");
         match(tok::semicolon, ";");
 
-        return make_read_stmt(id);
+        return make_read_stmt(m_nodes, id);
     }
-    return make_node();
+    return empty_node();
 }
 
 // write_stmt ::= '^mostrar' '(' expr ')' ';'
@@ -531,9 +562,9 @@ node_ptr parser::parse_write_stmt()
         auto expr = parse_expr();
         match(tok::r_par, ")");
         match(tok::semicolon, ";");
-        return make_write_stmt(std::move(expr));
+        return make_write_stmt(m_nodes, expr);
     }
-    return make_node();
+    return empty_node();
 }
 
 
@@ -551,28 +582,28 @@ node_ptr parser::parse_type()
     }
     if(rtid != -1) {
         next();
-        return make_type(rtid);
+        return make_type(m_nodes, rtid);
     }
-    return make_node();
+    return empty_node();
 }
 
 
 // param_list ::= expr
 //              | expr ',' param_list
 //              ;
-std::vector<node_ptr> parser::parse_param_list()
+node_list parser::parse_param_list()
 {
-    std::vector<node_ptr> params;
+    size_t mark = begin_list();
     while (auto parexpr = parse_expr()) {
         if (!parexpr->is_valid()) {
             break;
         }
-        params.push_back(std::move(parexpr));
+        m_pending.push_back(parexpr);
         if (is_token(',')) {
             next();
         }
     }
-    return params;
+    return end_list(mark);
 }
 
 
@@ -581,9 +612,9 @@ std::vector<node_ptr> parser::parse_param_list()
 //            | type 'ident' ',' arg_list
 //            ;
 //
-std::vector<node_ptr> parser::parse_arg_list()
+node_list parser::parse_arg_list()
 {
-    std::vector<node_ptr> args;
+    size_t mark = begin_list();
     while (auto argtype = parse_type()) {
         if (!argtype->is_valid()) {
             break;
@@ -592,14 +623,24 @@ std::vector<node_ptr> parser::parse_arg_list()
         if (!is_token(tok::identifier)) {
             expect_error("um identificador");
         }
-        std::string name = m_lex.token();
+        name_id name = intern_token();
         next();
-        args.push_back(make_argument(name, std::move(argtype)));
+        m_pending.push_back(make_argument(m_nodes, name, argtype));
         if (is_token(',')) {
             next();
         }
     }
-    return args;
+    return end_list(mark);
+}
+
+// Move os nós empilhados desde mark para uma lista na arena. As listas
+// aninhadas (p.ex. os statements de um if dentro de outro bloco) são
+// fechadas antes da lista que as contém, então a pilha se mantém ordenada.
+node_list parser::end_list(size_t mark)
+{
+    auto list = make_list(m_nodes, m_pending.data() + mark, m_pending.size() - mark);
+    m_pending.resize(mark);
+    return list;
 }
 
 // log ::= '>' | '<' | '=' | '>=' | '<=' | '!=' | 'tu' | 'eu'
@@ -6,9 +6,11 @@
 
 #include <stdexcept>
 #include <string>
-#include <memory>
+#include <vector>
+#include "arena.h"
 #include "lexer.h"
 #include "ast.h"
+#include "interner.h"
 
 namespace ptb
 {
@@ -21,11 +23,14 @@ struct parser_error : public std::runtime_error {
 class parser
 {
     lexer& m_lex;
+    arena& m_nodes;
 
+    // pilha de nós das listas em construção, copiadas para a arena no fim
+    std::vector<ast::node_ptr> m_pending;
     ast::node_ptr m_program;
     bool m_main_defined;
 public:
-    parser(lexer& lex);
+    parser(lexer& lex, arena& nodes);
 
     void run();
     const ast::node_ptr& get_ast() { return m_program; }
@@ -33,19 +38,23 @@ private:
     bool is_token(int token) {
         return (m_lex.get_token() == token);
     }
-    bool is_next_token(int token) {
-        return (m_lex.peek_next_token() == token);
+    // verifica o token n posições depois do atual
+    bool is_next_token(int token, size_t n = 1) {
+        return (m_lex.peek_token(n) == token);
     }
 
     void next() { m_lex.consume(); }
+    name_id intern_token() {
+        return names().intern(m_lex.token_text(), m_lex.token_length());
+    }
 //    void match(int token, const std::string &str);
 
     void expect_error_(std::string const& expected);
     ast::node_ptr parse_program();
     ast::node_ptr parse_decl();
 
-    std::vector<ast::node_ptr> parse_decl_list();
-    std::vector<ast::node_ptr> parse_stmt_list();
+    ast::node_list parse_decl_list();
+    ast::node_list parse_stmt_list();
     ast::node_ptr parse_stmt();
     ast::node_ptr parse_if_stmt();
     ast::node_ptr parse_while_stmt();
@@ -64,9 +73,12 @@ private:
 
     ast::node_ptr parse_type();
 
-    std::vector<ast::node_ptr> parse_param_list();
-    std::vector<ast::node_ptr> parse_arg_list();
+    ast::node_list parse_param_list();
+    ast::node_list parse_arg_list();
     int parse_logical_op();
+
+    size_t begin_list() { return m_pending.size(); }
+    ast::node_list end_list(size_t mark);
 };
 
 }
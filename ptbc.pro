@@ -5,6 +5,7 @@ CONFIG += exceptions
 
 SOURCES += main.cpp \
     lexer.cpp \
+    lexbench.cpp \
     parser.cpp \
     cppfmt/format.cpp \
     codegen.cpp \
@@ -12,10 +13,24 @@ SOURCES += main.cpp \
     dotexport.cpp \
     jvmcodegen.cpp \
     symtable.cpp \
-    optimizer.cpp
+    optimizer.cpp \
+    interner.cpp \
+    charscan.cpp \
+    arena.cpp \
+    flatast.cpp \
+    ir.cpp \
+    irbuilder.cpp \
+    irpass.cpp \
+    cfg.cpp \
+    dataflow.cpp \
+    timing.cpp \
+    jvmasm.cpp \
+    classfile.cpp \
+    jvmpeephole.cpp
 
 HEADERS += \
     lexer.h \
+    lexbench.h \
     tokens.h \
     parser.h \
     cppfmt/format.h \
@@ -26,5 +41,18 @@ HEADERS += \
     symtable.h \
     jvmcodegen.h \
     types.h \
-    optimizer.h
+    optimizer.h \
+    interner.h \
+    charscan.h \
+    arena.h \
+    flatast.h \
+    ir.h \
+    irbuilder.h \
+    irpass.h \
+    cfg.h \
+    dataflow.h \
+    timing.h \
+    jvmasm.h \
+    classfile.h \
+    jvmpeephole.h
 
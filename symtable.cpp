@@ -1,26 +1,67 @@
 
-#include <memory>
-#include "cppfmt/format.h"
 #include "symtable.h"
 
 
 namespace ptb {
 
-scope_ptr symbol_table::get_scope(int id)
+int symbol_table::new_scope(int prev)
 {
-    if (scopes.find(id) != scopes.end())
-        return scopes[id];
-    return nullptr;
+    int id = static_cast<int>(m_scopes.size());
+    m_scopes.emplace_back(prev, id);
+    return id;
 }
 
-void symbol_table::put_scope(int id, scope_ptr scope)
+void symbol_table::bind(symbol &sym)
 {
-    if (scopes.find(id) != scopes.end()) {
-        fmt::printf("Escopo %d ja existe\n", id);
-        return;
+    if (sym.name >= m_visible.size()) {
+        m_visible.resize(names().size(), nullptr);
     }
-    if (scope)
-        scopes[id] = scope;
+    sym.shadowed = m_visible[sym.name];
+    m_visible[sym.name] = &sym;
+}
+
+void symbol_table::enter(int id)
+{
+    // blocos vazios não têm escopo, mas ainda são empilhados
+    m_active.push_back(id);
+    if (id >= 0) {
+        for (auto sym : m_scopes[id].symbols) {
+            bind(*sym);
+        }
+    }
+}
+
+void symbol_table::leave()
+{
+    int id = m_active.back();
+    m_active.pop_back();
+    if (id >= 0) {
+        auto &symbols = m_scopes[id].symbols;
+        for (auto it = symbols.rbegin(); it != symbols.rend(); ++it) {
+            m_visible[(*it)->name] = (*it)->shadowed;
+            (*it)->shadowed = nullptr;
+        }
+    }
+}
+
+symbol& symbol_table::insert(const symbol &sym)
+{
+    int id = current();
+    if (sym.name < m_visible.size() && m_visible[sym.name] != nullptr &&
+            m_visible[sym.name]->owner == id) {
+        symbol &prev = *m_visible[sym.name];
+        symbol *shadowed = prev.shadowed;
+        prev = sym;
+        prev.owner = id;
+        prev.shadowed = shadowed;
+        return prev;
+    }
+    m_symbols.push_back(sym);
+    symbol &added = m_symbols.back();
+    added.owner = id;
+    m_scopes[id].symbols.push_back(&added);
+    bind(added);
+    return added;
 }
 
 
@@ -2,11 +2,13 @@
 // Pararatibum - A linguagem do momento
 // -----------------------------------------------------------------------------
 
-#include <map>
+#include <deque>
 #include <string>
 #include <memory>
+#include <vector>
 #include "cppfmt/format.h"
 #include "types.h"
+#include "interner.h"
 
 #pragma once
 
@@ -15,60 +17,82 @@ namespace ptb {
 struct symbol {
     int type;
     int c_type() const { return type & ~types::function; }
-    std::string name;
+    name_id name;
     int scope_id;
     bool is_valid() {
         return type != 0;
     }
-    symbol() : type(0) {}
-    symbol(const std::string &name_, int type_) :
+    symbol() : type(0), name(0), scope_id(0) {}
+    symbol(name_id name_, int type_) :
         type(type_), name(name_), scope_id(0) {}
-    symbol(const std::string &name_, int type_, int sid) :
+    symbol(name_id name_, int type_, int sid) :
         type(type_), name(name_), scope_id(sid) {}
 
     // informações utilizadas pelo gerador de código
     int local = -1;
     std::string signature;
+
+    // escopo que declarou o símbolo e a declaração com o mesmo nome que
+    // ele esconde enquanto visível
+    int owner = -1;
+    symbol *shadowed = nullptr;
 };
 
 // Baseado na implementação do livro do Dragão
 struct scope {
-    std::shared_ptr<scope> prev;
-    std::map<std::string, symbol> symbols;
+    int prev;
     int id;
+    // símbolos declarados no escopo, guardados em symbol_table
+    std::vector<symbol*> symbols;
 
-    scope(std::shared_ptr<scope> prev_, int id_) : prev(prev_), id(id_) {
+    scope(int prev_, int id_) : prev(prev_), id(id_) {
     }
+};
 
-    void insert(const std::string &name, const symbol &sym) {
-        symbols[name] = sym;
-//        fmt::printf("Inserindo simbolo %s no escopo %d\n", name, id);
-    }
+// Além de guardar os escopos, a tabela resolve nomes durante o percurso da
+// árvore. Para cada nome é mantida a declaração visível no momento,
+// encadeada com as declarações que ela esconde (symbol::shadowed). Entrar
+// num escopo torna seus símbolos visíveis e sair restaura os anteriores,
+// então a busca é um acesso direto pelo name_id, não importa a profundidade
+// do aninhamento.
+//
+// Os escopos ficam num vetor indexado pelo id e os símbolos num pool
+// próprio, onde não mudam de endereço (a AST guarda ponteiros para eles).
+struct symbol_table {
+    // cria um escopo filho de prev (-1 para nenhum) e devolve o id
+    int new_scope(int prev);
+    scope& get_scope(int id) { return m_scopes[id]; }
+    size_t scope_count() const { return m_scopes.size(); }
+
+    // id -1 representa um bloco vazio, que não tem escopo
+    void enter(int id);
+    void leave();
+    int current() { return m_active.back(); }
 
-    symbol& get(const std::string &name) {
-        auto cscope = this;
-        while (cscope != nullptr) {
-            if (cscope->symbols.find(name) != cscope->symbols.end()) {
-//                fmt::printf("Encontrou simbolo %s no escopo %d\n", name, cscope->id);
-                return cscope->symbols[name];
-            }
-            cscope = cscope->prev.get();
-        }
+    // declara sym no escopo atual, substituindo uma declaração do mesmo
+    // nome feita neste escopo. O símbolo guardado não muda de endereço.
+    symbol& insert(const symbol &sym);
+    // declaração válida visível de name ou nullptr
+    symbol *find(name_id name) {
+        symbol *sym = name < m_visible.size() ? m_visible[name] : nullptr;
+        return sym != nullptr && sym->is_valid() ? sym : nullptr;
+    }
+    symbol& lookup(name_id name) {
+        if (symbol *sym = find(name))
+            return *sym;
         static symbol defsym;
+        defsym = symbol();
         return defsym;
     }
-};
-
-typedef std::shared_ptr<scope> scope_ptr;
 
-struct symbol_table {
-    std::map<int, scope_ptr> scopes;
-    scope_ptr get_scope(int id);
-    void put_scope(int id, scope_ptr scope);
+private:
+    void bind(symbol &sym);
+    std::vector<scope> m_scopes;
+    std::deque<symbol> m_symbols;
+    std::vector<symbol*> m_visible;
+    std::vector<int> m_active;
 };
 
 typedef std::shared_ptr<symbol_table> symbol_table_ptr;
 
 } // ptb
-
-
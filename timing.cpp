@@ -0,0 +1,36 @@
+// -----------------------------------------------------------------------------
+// Pararatibum - A linguagem do momento
+// -----------------------------------------------------------------------------
+
+#include <cppfmt/format.h>
+#include "timing.h"
+
+namespace ptb { namespace ir {
+
+timings& timing()
+{
+    static timings table;
+    return table;
+}
+
+void timings::add(const char *name, double ms)
+{
+    for (auto& e : m_entries) {
+        if (e.name == name) {
+            e.ms += ms;
+            e.count++;
+            return;
+        }
+    }
+    m_entries.push_back(entry{name, ms, 1});
+}
+
+void timings::print(std::ostream &out) const
+{
+    for (const auto& e : m_entries) {
+        out << fmt::sprintf("%-22s %10.3f ms %8u execucoes\n", e.name, e.ms, e.count);
+    }
+}
+
+} // ir
+} // ptb
@@ -0,0 +1,66 @@
+// -----------------------------------------------------------------------------
+// Pararatibum - A linguagem do momento
+// -----------------------------------------------------------------------------
+
+#pragma once
+
+#include <chrono>
+#include <ostream>
+#include <vector>
+
+namespace ptb { namespace ir {
+
+// Tempo acumulado por passe e por análise, para medir o custo de cada um
+// em programas grandes. Só mede quando habilitado (opção -tempo). O tempo
+// de uma análise também entra no tempo do passe que a usou.
+class timings
+{
+public:
+    timings() : m_enabled(false) {}
+
+    bool enabled() const { return m_enabled; }
+    void enable(bool on) { m_enabled = on; }
+
+    // name precisa ser um literal: os nomes são comparados pelo endereço
+    void add(const char *name, double ms);
+    void print(std::ostream &out) const;
+
+private:
+    struct entry {
+        const char *name;
+        double ms;
+        unsigned count;
+    };
+
+    bool m_enabled;
+    std::vector<entry> m_entries;
+};
+
+// Tabela compartilhada pelos passes e análises da IR
+timings& timing();
+
+// Mede o tempo até o fim do escopo e acumula em timing()
+class scoped_timer
+{
+public:
+    explicit scoped_timer(const char *name) :
+        m_name(timing().enabled() ? name : nullptr) {
+        if (m_name) {
+            m_start = std::chrono::steady_clock::now();
+        }
+    }
+    ~scoped_timer() {
+        if (m_name) {
+            std::chrono::duration<double, std::milli> elapsed =
+                std::chrono::steady_clock::now() - m_start;
+            timing().add(m_name, elapsed.count());
+        }
+    }
+
+private:
+    const char *m_name;
+    std::chrono::steady_clock::time_point m_start;
+};
+
+} // ir
+} // ptb
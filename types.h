@@ -14,6 +14,8 @@ enum {
     character,
     // flags
     function = 0x8000,
+    // tipo de uma expressão ainda não calculado (ast::node::eval_type)
+    unknown = -2,
 };
 
 } // types